@@ -0,0 +1,109 @@
+// Google Benchmark runs of every stepper and its reference sort, on every input
+// distribution, without the visualizer's window, audio or worker thread. Each case is
+// named <algorithm>/<impl>/<distribution>/<n>, so --benchmark_filter picks cases out
+// of the grid, and runs saved with --benchmark_out can be compared with benchmark's
+// tools/compare.py to catch regressions.
+#include "sortcore.h"
+
+#include <benchmark/benchmark.h>
+#include <iostream>
+
+// --- CASES ---
+const uint64_t SORTBENCH_SEED = 1;    // Fixed, so every run sorts the same inputs
+const int SORTBENCH_RANGE = 100;      // The --bench default
+const int SORTBENCH_SIZES[] = {1 << 10, 1 << 14, 1 << 17};
+const int SORTBENCH_QUADRATIC_LIMIT = 1 << 14; // O(N^2) sorts are skipped above this N
+
+using IntAlgorithm = BenchAlgorithm<int, std::less<int>>;
+
+ScratchArena arena; // Shared by every stepper run, like the visualizer's worker
+
+// Same generator streams as --bench, so a case here sorts the keys --bench --seed 1 does.
+std::vector<int> CaseInput(int dist, int n) {
+    Xoshiro256 rng(SORTBENCH_SEED ^ (uint64_t)dist << 40 ^ (uint64_t)n);
+    std::vector<int> keys;
+    GenerateInput((InputDistribution)dist, keys, n, SORTBENCH_RANGE, rng);
+    return keys;
+}
+
+// One iteration sorts a fresh copy of the input; only the sort is timed. The counts
+// are the same every iteration, so they are reported as they are, not summed.
+void BenchStepper(benchmark::State& state, const IntAlgorithm& algo, bool network, std::vector<int> input) {
+    std::vector<int> v;
+    std::unique_ptr<SortStepper> s;
+    for (auto _ : state) {
+        state.PauseTiming();
+        v = input;
+        s.reset();
+        state.ResumeTiming();
+        s = CreateStepper(algo.mode, v, arena, network);
+        while (!s->isDone()) s->step();
+        benchmark::DoNotOptimize(v.data());
+        benchmark::ClobberMemory();
+    }
+    if (!s || !std::is_sorted(v.begin(), v.end())) { state.SkipWithError("output is not sorted"); return; }
+    state.counters["comparisons"] = (double)s->comparisons;
+    state.counters["swaps"] = (double)s->swaps;
+    state.counters["bytes_read"] = (double)s->bytesRead;
+    state.counters["bytes_written"] = (double)s->bytesWritten;
+    state.counters["peak_aux_bytes"] = (double)s->peakAuxBytes;
+    state.SetItemsProcessed(state.iterations() * (int64_t)input.size());
+    state.SetBytesProcessed(state.iterations() * (int64_t)(input.size() * sizeof(int)));
+}
+
+// The references read the `networkLeaves` global, so it is set for each case.
+void BenchReference(benchmark::State& state, const IntAlgorithm& algo, bool network, std::vector<int> input) {
+    std::vector<int> v;
+    OpCounts c;
+    networkLeaves = network;
+    for (auto _ : state) {
+        state.PauseTiming();
+        v = input;
+        c = {};
+        state.ResumeTiming();
+        algo.reference(v, c);
+        benchmark::DoNotOptimize(v.data());
+        benchmark::ClobberMemory();
+    }
+    networkLeaves = false;
+    if (!std::is_sorted(v.begin(), v.end())) { state.SkipWithError("output is not sorted"); return; }
+    state.counters["comparisons"] = (double)c.comparisons;
+    state.counters["swaps"] = (double)c.swaps;
+    state.SetItemsProcessed(state.iterations() * (int64_t)input.size());
+    state.SetBytesProcessed(state.iterations() * (int64_t)(input.size() * sizeof(int)));
+}
+
+// Registers the whole algorithm x impl x distribution x N grid.
+void RegisterCases() {
+    bool gpu = gpuCompute.ready();
+    for (const IntAlgorithm& algo : BENCH_ALGORITHMS<int, std::less<int>>) {
+        if (algo.gpu && !gpu) continue;
+        for (int network = 0; network <= (!algo.library && UsesNetworkLeaves(algo.mode)); network++) {
+            for (int d = 0; d < NUM_INPUT_DISTRIBUTIONS; d++) {
+                for (int n : SORTBENCH_SIZES) {
+                    if (algo.quadratic && n > SORTBENCH_QUADRATIC_LIMIT) continue;
+                    std::string tail = std::string("/") + INPUT_DISTRIBUTION_NAMES[d] + "/" + std::to_string(n);
+                    std::vector<int> input = CaseInput(d, n);
+                    if (!algo.library) {
+                        std::string name = std::string(algo.id) + (network ? "/stepper-network" : "/stepper") + tail;
+                        benchmark::RegisterBenchmark(name.c_str(), BenchStepper, std::cref(algo), network != 0, input)->Unit(benchmark::kMicrosecond);
+                    }
+                    const char* impl = algo.library ? "/library" : network ? "/reference-network" : "/reference";
+                    std::string name = std::string(algo.id) + impl + tail;
+                    benchmark::RegisterBenchmark(name.c_str(), BenchReference, std::cref(algo), network != 0, input)->Unit(benchmark::kMicrosecond);
+                }
+            }
+        }
+    }
+    if (!gpu) std::cerr << "gpu_bitonic skipped: " << gpuCompute.status() << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    RegisterCases();
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    gpuCompute.shutdown();
+    return 0;
+}
@@ -2,100 +2,1222 @@
 #include <SDL3/SDL_main.h>
 #include <vector>
 #include <iostream>
-#include <ctime>
 #include <algorithm>
 #include <cmath>
 #include <atomic>
+#include <memory>
 #include <string>
-#include <sstream>
+#include <charconv>
+#include <cstdlib>
+#include <new>
 #include <iomanip> // For decimal precision
+#include <fstream>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <random>
+#include <cstring>
+#include <climits>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#if defined(VISUALIZER_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "sortcore.h"
 
 // --- CONFIGURATION ---
 const int WINDOW_WIDTH = 1280;
 const int WINDOW_HEIGHT = 1000;
-const int NUM_RECTANGLES = 150;
-const int DELAY_SHUFFLE = 1;
+const double SHUFFLE_STEPS_PER_SECOND = 1000.0; // One swap per millisecond...
+const double MAX_SHUFFLE_SECONDS = 1.0;         // ...unless that would take longer than this
 const float TEXT_SCALE = 2.0f;
 const float LINE_HEIGHT = 18.0f;
 
+// --- ARRAY SIZE ---
+// N and the value range are runtime parameters (--n / --range, and the [ ] - = keys).
+// Values are drawn from [MIN_VALUE, MIN_VALUE + valueRange).
+const int DEFAULT_NUM_ELEMENTS = 150;
+const int MAX_NUM_ELEMENTS = 1 << 24;
+const int DEFAULT_VALUE_RANGE = 100;
+const int MAX_VALUE_RANGE = 1 << 30;
+const float MAX_BAR_HEIGHT = 730.0f;            // Height of the tallest possible bar
+const float BAR_BOTTOM_Y = WINDOW_HEIGHT - 30.0f;
+int numElements = DEFAULT_NUM_ELEMENTS;
+int valueRange = DEFAULT_VALUE_RANGE;
+
 // --- DYNAMIC SPEED ---
-int currentDelay = 0;
+// The sort runs on the worker thread's fixed-timestep scheduler: every slice the elapsed
+// wall time is turned into a step budget, so a slice can run a fraction of a step or thousands.
+const double DEFAULT_STEPS_PER_SECOND = 1000.0;
+const double MIN_STEPS_PER_SECOND = 1.0;
+const double MAX_STEPS_PER_SECOND = 50000000.0;
+const double SPEED_FACTOR = 1.5;           // UP/DOWN multiply or divide the rate by this
+const double MAX_FRAME_TIME = 0.25;        // Longer stalls are not caught up on
+const int MAX_STEPS_PER_SLICE = 2000000;   // Keeps a worker slice bounded at any rate
+const double WORKER_SLICE_SECONDS = 1.0 / 240.0; // The worker runs and publishes at most this often
+double stepsPerSecond = DEFAULT_STEPS_PER_SECOND;
+
+// D switches to pacing: the worker picks the rate so the whole sort takes targetSeconds,
+// whatever the algorithm and N. UP/DOWN then shorten or lengthen the target instead.
+const double DEFAULT_TARGET_SECONDS = 10.0;
+const double MIN_TARGET_SECONDS = 0.5;
+const double MAX_TARGET_SECONDS = 600.0;
+const double MIN_PACED_STEPS_PER_SECOND = 0.01; // A 2-element sort still takes its time
+const double PACE_SMOOTHING = 0.5;         // Weight of each new steps-per-progress measurement
+const double PACE_OVERRUN_SECONDS = 0.1;   // A sort past its target finishes what is left in about this long
+bool paceToTarget = false;
+double targetSeconds = DEFAULT_TARGET_SECONDS;
 
 // --- AUDIO CONFIG ---
 const int SAMPLE_RATE = 44100;
 const float VOLUME = 0.05f;
+const int MAX_VOICES = 16;            // Simultaneous decaying tones
+const double TONE_DECAY_SECONDS = 0.08;
+const double AUDIO_LATENCY_SECONDS = 0.05; // Audio trails the sort by this much so events arrive in time
+const int AUDIO_CHUNK = 512;          // Samples mixed per SDL_PutAudioStreamData call
 
 // --- MODES ---
-enum SortMode {
-    BUBBLE_SORT, SELECTION_SORT, INSERTION_SORT, QUICK_SORT, MERGE_SORT
+// SortMode and SORT_MODE_NAMES are in sortcore.h. The overlay's complexity and
+// description lines, per mode:
+struct AlgorithmInfo {
+    std::string_view complexity;
+    std::string_view description;
+};
+const AlgorithmInfo ALGORITHM_INFO[NUM_SORT_MODES] = {
+    {"O(N^2) - Slow", "Swaps adjacent elements repeatedly."},
+    {"O(N^2) - Slow", "Finds the smallest item and moves it."},
+    {"O(N^2) - OK for small lists", "Builds sorted array one item at a time."},
+    {"O(N log N) - Fast", "Divides list around a pivot point."},
+    {"O(N log N) - Stable", "Divides list in half, sorts, and merges."},
+    {"O(N log N) - Stable, 4 lanes", "Lanes merge the blocks of each pass at once."},
+    {"O(N log N) - Fast, 4 lanes", "Lanes partition ranges, stealing when idle."},
+    {"O(N log N) - Worst case too", "Quicksort, heapsort if too deep, insertion when small."},
+    {"O(N log N) - Linear on sorted runs", "Quicksort that detects and breaks input patterns."},
+    {"O(N log N) - Stable, adaptive", "Finds natural runs and merges them, galloping."},
+    {"O(N + K) - No comparisons", "Counts each value, then writes them out in order."},
+    {"O(N) per digit - Stable", "Scatters into 256 buckets, lowest byte first."},
+    {"O(N) per digit - In place", "Swaps into buckets by top byte, then recurses."},
+    {"O(N log^2 N) - Sorting network", "Compare-exchange passes of fixed partner distance."},
+    {"O(N log^2 N) - Compute shader", "Each pass is one dispatch over the whole array."},
+    {"O(N log N) - In place", "Builds a max-heap, then moves its root to the end."},
+    {"O(N log^2 N) - Stable, in place", "Merges runs by binary search and rotation."},
+    {"~O(N^1.3) - In place", "Insertion sorts with Ciura's gaps 701, 301, .., 1."},
+    {"O(N^1.5) - In place", "Insertion sorts with Knuth's gaps (3^k - 1) / 2."},
+    {"O(N^2) worst - In place", "Insertion sorts with Shell's gaps N/2, N/4, .., 1."},
 };
 
+// Rough step count of a live sort of n elements, roughly one comparison or write per
+// step. Only the pacing's first guess: it gives way to what the stepper's progress shows.
+double EstimatedSortSteps(SortMode mode, int n) {
+    double size = std::max(n, 2), logN = std::log2(size);
+    switch (mode) {
+        case BUBBLE_SORT: case SELECTION_SORT: case INSERTION_SORT: return size * (size - 1) / 2;
+        case COUNTING_SORT: return 2 * size;
+        case LSD_RADIX_SORT: return 2 * size * sizeof(int);
+        case MSD_RADIX_SORT: return 2 * size * 2;
+        case MERGE_SORT: case PARALLEL_MERGE_SORT: return size * logN;
+        case BITONIC_SORT: return size / 2 * std::ceil(logN) * (std::ceil(logN) + 1) / 2;
+        case GPU_BITONIC_SORT: return std::ceil(logN) * (std::ceil(logN) + 1) / 2; // A step is a whole pass
+        case HEAP_SORT: return 2 * size * logN;
+        case IN_PLACE_MERGE_SORT: return size * logN * logN / 4;
+        case SHELL_SORT_CIURA: case SHELL_SORT_KNUTH: case SHELL_SORT_HALVING: return size * std::pow(size, 0.3);
+        default: return 1.5 * size * logN; // Partitioning sorts compare and swap
+    }
+}
+
 // --- GLOBAL VARIABLES ---
 std::vector<int> data;
 SortMode currentMode = BUBBLE_SORT;
 bool isSorted = false;
 bool isRunning = true;
 
-// Stats
-unsigned long long comparisons = 0;
-unsigned long long swaps = 0;
-
 // TIMER VARIABLES
-double preciseTimeMs = 0.0;
 Uint64 perfFreq = 0; // CPU Timer Frequency
 
 // Progress Tracking
 float currentMaxProgress = 0.0f;
 
-// Shuffle State
+// Shuffle State (the shuffle itself runs on the worker)
 bool isShuffling = false;
-int shuffle_i = 0;
 
-// Audio Communication
-std::atomic<int> targetHeight(0);
+// --- ALLOCATION COUNTER ---
+// Debug builds count every operator new per thread, so the main loop can assert that
+// a steady-state frame allocates nothing (see ALLOCATION_WARMUP_FRAMES).
+#ifndef NDEBUG
+thread_local unsigned long long threadAllocations = 0;
+
+void* operator new(size_t size) {
+    threadAllocations++;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+// GCC sees the malloc inside the replaced new and flags the free() that every delete inlines to
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+// The nothrow pair too (std::stable_sort's buffer), so every form shares malloc's heap
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    threadAllocations++;
+    return std::malloc(size ? size : 1);
+}
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+const int ALLOCATION_WARMUP_FRAMES = 120; // Frames without input before one must not allocate
+
+// --- AUDIO EVENTS ---
+// The sorting side pushes timestamped tone events into a lock-free single-producer /
+// single-consumer ring; the audio callback drains it and plays each event at the
+// sample offset matching its timestamp.
+struct ToneEvent {
+    Uint64 tick;   // SDL_GetPerformanceCounter() time the step happened
+    float pitch;   // Touched bar's value / the largest possible value
+};
+
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+public:
+    // Producer side. Drops the item when the consumer has fallen a full ring behind.
+    bool push(const T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == Capacity) return false;
+        slots[h & (Capacity - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+    // Consumer side.
+    const T* peek() const {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) return nullptr;
+        return &slots[t & (Capacity - 1)];
+    }
+    void pop() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+private:
+    T slots[Capacity];
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
+
+const int MAX_TONES_PER_SLICE = 2;  // Steps in a worker slice are sampled down to this many tones
+SpscRing<ToneEvent, 4096> toneEvents;
+
+void PushTone(Uint64 tick, float pitch) { toneEvents.push({tick, pitch}); }
+
+// --- HARDWARE COUNTERS ---
+// Optional CPU counters for a sort run (H in the visualizer, --counters in the bench),
+// read through Linux's perf_event_open. Each counter is opened on its own, for the
+// calling thread and user space only, so one the CPU or VM lacks just stays blank.
+// When the kernel has to multiplex them, readings are scaled up by the share of the
+// run they were scheduled for. Other platforms, or a kernel whose perf_event_paranoid
+// setting forbids it, report no counters at all.
+enum HardwareCounter { HW_CYCLES, HW_INSTRUCTIONS, HW_L1D_MISSES, HW_LLC_MISSES, HW_BRANCH_MISSES };
+const int NUM_HW_COUNTERS = HW_BRANCH_MISSES + 1;
+const char* HW_COUNTER_NAMES[NUM_HW_COUNTERS] = {"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"};
+
+struct HardwareCounts {
+    uint64_t value[NUM_HW_COUNTERS] = {};
+    unsigned valid = 0; // Bit c is set when counter c was read
+
+    bool has(int c) const { return (valid >> c) & 1; }
+    HardwareCounts& operator+=(const HardwareCounts& other) {
+        for (int c = 0; c < NUM_HW_COUNTERS; c++) value[c] += other.value[c];
+        valid |= other.valid;
+        return *this;
+    }
+};
+
+class PerfCounters {
+public:
+    PerfCounters() { std::fill(std::begin(fds), std::end(fds), -1); }
+    ~PerfCounters() { close(); }
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // Opens the counters on the calling thread, the only one they will count.
+    // Returns whether any of them could be opened.
+    bool open() {
+        close();
+#if defined(__linux__)
+        const uint64_t L1D_READ_MISS = PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+        const uint64_t LLC_READ_MISS = PERF_COUNT_HW_CACHE_LL | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+        const uint32_t types[NUM_HW_COUNTERS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE};
+        const uint64_t configs[NUM_HW_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, L1D_READ_MISS, LLC_READ_MISS, PERF_COUNT_HW_BRANCH_MISSES};
+        for (int c = 0; c < NUM_HW_COUNTERS; c++) {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = types[c];
+            attr.config = configs[c];
+            attr.disabled = 1; attr.exclude_kernel = 1; attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[c] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+#endif
+        return available();
+    }
+    bool available() const { return std::any_of(std::begin(fds), std::end(fds), [](int fd) { return fd >= 0; }); }
+
+    void start() {
+#if defined(__linux__)
+        for (int fd : fds) if (fd >= 0) { ioctl(fd, PERF_EVENT_IOC_RESET, 0); ioctl(fd, PERF_EVENT_IOC_ENABLE, 0); }
+#endif
+    }
+    // Counts since start().
+    HardwareCounts stop() {
+        HardwareCounts counts;
+#if defined(__linux__)
+        for (int c = 0; c < NUM_HW_COUNTERS; c++) {
+            if (fds[c] < 0) continue;
+            ioctl(fds[c], PERF_EVENT_IOC_DISABLE, 0);
+            uint64_t reading[3]; // value, time enabled, time running
+            if (::read(fds[c], reading, sizeof(reading)) != sizeof(reading) || reading[2] == 0) continue;
+            counts.value[c] = reading[2] < reading[1] ? (uint64_t)((double)reading[0] * reading[1] / reading[2]) : reading[0];
+            counts.valid |= 1u << c;
+        }
+#endif
+        return counts;
+    }
+
+private:
+    int fds[NUM_HW_COUNTERS];
+
+    void close() {
+#if defined(__linux__)
+        for (int& fd : fds) if (fd >= 0) { ::close(fd); fd = -1; }
+#endif
+    }
+};
+
+// --- DATA FILES ---
+// Arrays and recorded traces share one compact binary format (.svz): a 40-byte header,
+// then the payload, both in native little-endian byte order.
+//   Array: the keys as raw int32, so an uncompressed file can be memory-mapped and
+//          sorted in place (--external does) or read with one copy.
+//   Trace: the input array, then each operation as varints. The first holds the
+//          zigzag delta of its index from the previous operation's index, shifted
+//          left past the two type bits. The second holds the argument: compares and
+//          swaps as a zigzag delta from the index, writes as the raw XOR, networks as
+//          size | writes << 8. Sorts touch nearby elements, so most take 2-3 bytes
+//          instead of TraceOp's 8.
+// Compressed files store their arrays as zigzag-delta varints too, and zstd the whole
+// payload. They need a build with VISUALIZER_HAVE_ZSTD to write or read.
+static_assert(std::endian::native == std::endian::little, "data files are little-endian");
+
+enum DataFileKind : uint16_t { DATA_ARRAY = 1, DATA_TRACE = 2 };
+enum DataFileFlags : uint32_t { DATA_VARINT_KEYS = 1, DATA_ZSTD = 2 };
+
+struct DataFileHeader {
+    char magic[4] = {'S', 'V', 'Z', 'F'};
+    uint16_t version = 1;
+    uint16_t kind = DATA_ARRAY;
+    uint32_t flags = 0;
+    uint32_t mode = 0;          // SortMode that recorded a trace
+    uint64_t elements = 0;      // Keys in the array, or in the trace's input
+    uint64_t operations = 0;    // Trace operations
+    uint64_t payloadBytes = 0;  // Stored (possibly compressed) bytes after the header
+};
+static_assert(sizeof(DataFileHeader) == 40, "the header is part of the file format");
+
+// Encoded sizes, which bound the counts a header may claim for its payload. A varint
+// key is a zigzagged delta of two int32s (up to 33 bits); an operation is two varints,
+// each of at least one byte and at most 35 bits.
+const uint64_t MAX_VARINT_KEY_BYTES = 5;
+const uint64_t MIN_OP_BYTES = 2;
+const uint64_t MAX_OP_BYTES = 10;
+
+// A loaded file: the array (a trace's input), plus the operations of a trace.
+struct DataFile {
+    DataFileHeader header;
+    std::vector<int> values;
+    std::vector<TraceOp> ops;
+};
 
-// --- ALGORITHM STATE VARIABLES ---
-int i = 0, j = 0;
-int minIdx = 0;
+// A whole file mapped into memory: an existing file read-only, or a new one read-write
+// at a given size. keys() starts `offset` bytes in, past a data file header. On Windows
+// the read side opens with FILE_FLAG_SEQUENTIAL_SCAN and the advice calls do nothing.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    const unsigned char* data() const { return static_cast<const unsigned char*>(base); }
+    size_t size() const { return bytes; }
+    void setOffset(size_t headerBytes) { offset = std::min(headerBytes, bytes); }
+    size_t count() const { return (bytes - offset) / sizeof(int); }
+    int* keys() const { return reinterpret_cast<int*>(static_cast<char*>(base) + offset); }
+
+#if defined(_WIN32)
+    bool openRead(const std::string& path) {
+        close();
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        LARGE_INTEGER size;
+        if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size)) return false;
+        bytes = (size_t)size.QuadPart;
+        return map(false);
+    }
+    bool create(const std::string& path, size_t size) {
+        close();
+        file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        bytes = size;
+        return map(true); // Mapping past the end grows the file
+    }
+    void close() {
+        if (base) UnmapViewOfFile(base);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        base = nullptr; mapping = nullptr; file = INVALID_HANDLE_VALUE; bytes = offset = 0;
+    }
+    void advise(bool sequential) {}
+    void willNeed(size_t first, size_t keys) {}
+#else
+    bool openRead(const std::string& path) {
+        close();
+        fd = ::open(path.c_str(), O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0) return false;
+        bytes = (size_t)info.st_size;
+        return map(false);
+    }
+    bool create(const std::string& path, size_t size) {
+        close();
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ftruncate(fd, (off_t)size) != 0) return false;
+        bytes = size;
+        return map(true);
+    }
+    void close() {
+        if (base) munmap(base, bytes);
+        if (fd >= 0) ::close(fd);
+        base = nullptr; fd = -1; bytes = offset = 0;
+    }
+    // Sequential doubles the kernel's read-ahead window and drops pages behind the
+    // reader; random disables read-ahead altogether.
+    void advise(bool sequential) { if (base) madvise(base, bytes, sequential ? MADV_SEQUENTIAL : MADV_RANDOM); }
+    // Starts reading in keys [first, first + keys) without waiting for them.
+    void willNeed(size_t first, size_t keys) {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t begin = (offset + first * sizeof(int)) / page * page, end = std::min(bytes, offset + (first + keys) * sizeof(int));
+        if (base && begin < end) madvise(static_cast<char*>(base) + begin, end - begin, MADV_WILLNEED);
+    }
+#endif
+
+private:
+    void* base = nullptr;
+    size_t bytes = 0, offset = 0;
+#if defined(_WIN32)
+    HANDLE file = INVALID_HANDLE_VALUE, mapping = nullptr;
+
+    bool map(bool writable) {
+        if (bytes == 0) return true; // Nothing to map; an empty file sorts trivially
+        mapping = CreateFileMappingA(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+                                     (DWORD)((uint64_t)bytes >> 32), (DWORD)bytes, nullptr);
+        if (mapping) base = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, bytes);
+        return base != nullptr;
+    }
+#else
+    int fd = -1;
+
+    bool map(bool writable) {
+        if (bytes == 0) return true;
+        void* p = mmap(nullptr, bytes, PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) return false;
+        base = p;
+        return true;
+    }
+#endif
+};
 
-// Quick Sort Specific
-std::vector<std::pair<int, int>> qsStack;
-int qs_l=0, qs_r=0, qs_i=0, qs_j=0;
-bool qs_partitionMode = false;
+uint64_t ZigZag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+int64_t UnZigZag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
 
-// Merge Sort Specific
-std::vector<int> ms_temp;
-int ms_curr_size=1, ms_left_start=0, ms_l=0, ms_m=0, ms_r=0, ms_i=0, ms_j=0, ms_k=0;
-bool ms_copying = false;
+void PutVarint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) { out.push_back((uint8_t)(v | 0x80)); v >>= 7; }
+    out.push_back((uint8_t)v);
+}
+bool GetVarint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t byte = *p++;
+        v |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+void EncodeKeys(std::vector<uint8_t>& out, const std::vector<int>& values, bool varint) {
+    if (!varint) {
+        const uint8_t* raw = reinterpret_cast<const uint8_t*>(values.data());
+        out.insert(out.end(), raw, raw + values.size() * sizeof(int));
+        return;
+    }
+    int64_t previous = 0;
+    for (int v : values) { PutVarint(out, ZigZag(v - previous)); previous = v; }
+}
+bool DecodeKeys(const uint8_t*& p, const uint8_t* end, bool varint, size_t n, std::vector<int>& values) {
+    if (!varint) {
+        if ((size_t)(end - p) / sizeof(int) < n) return false;
+        values.resize(n);
+        std::memcpy(values.data(), p, n * sizeof(int));
+        p += n * sizeof(int);
+        return true;
+    }
+    if ((size_t)(end - p) < n) return false; // Every varint takes at least a byte
+    values.clear();
+    values.reserve(n);
+    int64_t previous = 0;
+    for (size_t k = 0; k < n; k++) {
+        uint64_t v;
+        if (!GetVarint(p, end, v)) return false;
+        previous += UnZigZag(v);
+        values.push_back((int)previous);
+    }
+    return true;
+}
+
+// Checks that a decoded trace only touches [0, n) and that every network is an
+// opening marker, its writes, and a matching closing marker, as the replay assumes.
+bool ValidTrace(const std::vector<TraceOp>& ops, size_t n) {
+    for (size_t k = 0; k < ops.size(); k++) {
+        const TraceOp& op = ops[k];
+        if ((size_t)op.index() >= n) return false;
+        if ((op.type() == OP_COMPARE || op.type() == OP_SWAP) && (op.arg < 0 || (size_t)op.arg >= n)) return false;
+        if (op.type() != OP_NETWORK) continue;
+        size_t size = op.arg & 0xFF, writes = (size_t)op.arg >> 8;
+        if (size > NETWORK_MAX_SIZE || writes > size || op.index() + size > n || k + writes + 1 >= ops.size()) return false;
+        for (size_t w = 1; w <= writes; w++) if (ops[k + w].type() != OP_WRITE) return false;
+        const TraceOp& closing = ops[k + writes + 1];
+        if (closing.type() != OP_NETWORK || closing.code != op.code || closing.arg != op.arg) return false;
+        k += writes + 1;
+    }
+    return true;
+}
+
+// Writes the header and payload, zstd-compressing the payload when asked.
+bool WriteDataFile(const std::string& path, DataFileHeader header, const std::vector<uint8_t>& payload, bool compress, std::string& error) {
+    const std::vector<uint8_t>* stored = &payload;
+#if defined(VISUALIZER_HAVE_ZSTD)
+    std::vector<uint8_t> packed;
+    if (compress) {
+        packed.resize(ZSTD_compressBound(payload.size()));
+        size_t size = ZSTD_compress(packed.data(), packed.size(), payload.data(), payload.size(), ZSTD_CLEVEL_DEFAULT);
+        if (ZSTD_isError(size)) { error = ZSTD_getErrorName(size); return false; }
+        packed.resize(size);
+        stored = &packed;
+        header.flags |= DATA_ZSTD;
+    }
+#else
+    if (compress) { error = "built without zstd (VISUALIZER_HAVE_ZSTD)"; return false; }
+#endif
+    header.payloadBytes = stored->size();
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(stored->data()), (std::streamsize)stored->size());
+    if (!out) { error = "cannot write " + path; return false; }
+    return true;
+}
+
+bool SaveArray(const std::string& path, const std::vector<int>& values, bool compress, std::string& error) {
+    DataFileHeader header;
+    header.kind = DATA_ARRAY;
+    header.flags = compress ? (uint32_t)DATA_VARINT_KEYS : 0u; // Raw keys stay mappable
+    header.elements = values.size();
+    std::vector<uint8_t> payload;
+    EncodeKeys(payload, values, compress);
+    return WriteDataFile(path, header, payload, compress, error);
+}
+
+bool SaveTrace(const std::string& path, SortMode mode, const std::vector<int>& input, const OperationTrace& trace, bool compress, std::string& error) {
+    DataFileHeader header;
+    header.kind = DATA_TRACE;
+    header.flags = compress ? (uint32_t)DATA_VARINT_KEYS : 0u;
+    header.mode = mode;
+    header.elements = input.size();
+    header.operations = trace.size();
+    std::vector<uint8_t> payload;
+    payload.reserve(input.size() * sizeof(int) + trace.size() * 3);
+    EncodeKeys(payload, input, compress);
+    int previous = 0;
+    for (size_t k = 0; k < trace.size(); k++) {
+        const TraceOp& op = trace[k];
+        PutVarint(payload, ZigZag((int64_t)op.index() - previous) << 2 | op.type());
+        previous = op.index();
+        if (op.type() == OP_COMPARE || op.type() == OP_SWAP) PutVarint(payload, ZigZag((int64_t)op.arg - op.index()));
+        else PutVarint(payload, (uint32_t)op.arg);
+    }
+    return WriteDataFile(path, header, payload, compress, error);
+}
+
+// Bytes to skip before the keys of a mapped file: a raw data-file array has its header
+// there; any other file without the magic is taken as bare int32 keys. Fails for
+// traces and compressed arrays, which can't be used in place.
+bool MappableKeys(const MappedFile& file, size_t& offset, std::string& error) {
+    offset = 0;
+    DataFileHeader header;
+    if (file.size() < sizeof(header) || std::memcmp(file.data(), header.magic, 4) != 0) return true;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (header.kind != DATA_ARRAY || header.flags != 0) { error = "only uncompressed array files can be mapped"; return false; }
+    offset = sizeof(header);
+    return true;
+}
+
+// Reads an array or trace file through a read-only mapping. An uncompressed array is
+// copied straight out of the mapping; everything else is decoded from it.
+bool LoadDataFile(const std::string& path, DataFile& file, std::string& error) {
+    MappedFile mapped;
+    if (!mapped.openRead(path)) { error = "cannot open " + path; return false; }
+    DataFileHeader& header = file.header;
+    if (mapped.size() < sizeof(header)) { error = path + " is not a data file"; return false; }
+    std::memcpy(&header, mapped.data(), sizeof(header));
+    if (std::memcmp(header.magic, DataFileHeader().magic, 4) != 0 || header.version != 1 ||
+        (header.kind != DATA_ARRAY && header.kind != DATA_TRACE) || header.mode >= NUM_SORT_MODES) {
+        error = path + " is not a data file (or a newer version)"; return false;
+    }
+    if (header.payloadBytes > mapped.size() - sizeof(header)) { error = path + " is truncated"; return false; }
+    if (header.elements > (uint64_t)INT_MAX || header.operations > TRACE_CAPACITY) { error = path + " is too large to load"; return false; }
+    const uint8_t* p = mapped.data() + sizeof(header);
+    const uint8_t* end = p + header.payloadBytes;
+
+    std::vector<uint8_t> unpacked;
+    if (header.flags & DATA_ZSTD) {
+#if defined(VISUALIZER_HAVE_ZSTD)
+        unsigned long long size = ZSTD_getFrameContentSize(p, end - p);
+        if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN) { error = path + ": bad zstd frame"; return false; }
+        // No larger than the header's keys and operations can encode to
+        uint64_t keyBytes = header.flags & DATA_VARINT_KEYS ? MAX_VARINT_KEY_BYTES : sizeof(int);
+        uint64_t operations = header.kind == DATA_TRACE ? header.operations : 0;
+        if (size > header.elements * keyBytes + operations * MAX_OP_BYTES) { error = path + " is corrupt"; return false; }
+        unpacked.resize(size);
+        size_t got = ZSTD_decompress(unpacked.data(), unpacked.size(), p, end - p);
+        if (ZSTD_isError(got) || got != size) { error = path + ": " + ZSTD_getErrorName(got); return false; }
+        p = unpacked.data(); end = p + unpacked.size();
+#else
+        error = path + " is zstd-compressed, and this build has no zstd (VISUALIZER_HAVE_ZSTD)"; return false;
+#endif
+    }
+
+    bool corrupt = !DecodeKeys(p, end, header.flags & DATA_VARINT_KEYS, header.elements, file.values);
+    file.ops.clear();
+    if (!corrupt && header.kind == DATA_TRACE && (uint64_t)(end - p) / MIN_OP_BYTES < header.operations) corrupt = true;
+    if (!corrupt && header.kind == DATA_TRACE) {
+        file.ops.reserve(header.operations);
+        int64_t index = 0;
+        for (uint64_t k = 0; k < header.operations && !corrupt; k++) {
+            uint64_t tag, arg;
+            corrupt = !GetVarint(p, end, tag) || !GetVarint(p, end, arg);
+            TraceOpType type = (TraceOpType)(tag & 3);
+            index += UnZigZag(tag >> 2);
+            int64_t value = type == OP_COMPARE || type == OP_SWAP ? index + UnZigZag(arg) : (int64_t)(uint32_t)arg;
+            corrupt |= index < 0 || index >= (int64_t)header.elements;
+            file.ops.push_back({((uint32_t)type << 30) | (uint32_t)index, (int32_t)value});
+        }
+        corrupt = corrupt || !ValidTrace(file.ops, file.values.size());
+    }
+    if (corrupt) { error = path + " is corrupt"; return false; }
+    return true;
+}
+
+// Shifts loaded keys so the smallest is MIN_VALUE, which keeps their order and ties, and
+// so what every comparison sort does with them. Fails if they span more than
+// MAX_VALUE_RANGE values.
+bool ShiftKeys(std::vector<int>& keys, std::string& error) {
+    if (keys.empty()) return true;
+    auto [low, high] = std::minmax_element(keys.begin(), keys.end());
+    if ((long long)*high - *low >= MAX_VALUE_RANGE) { error = "keys span more than the largest value range (2^30)"; return false; }
+    long long shift = (long long)MIN_VALUE - *low;
+    if (shift) for (int& k : keys) k = (int)(k + shift);
+    return true;
+}
+
+// --- INPUT DISTRIBUTIONS ---
+// The generators are in sortcore.h; this is which one the visualizer uses, and the
+// random streams behind its arrays and shuffles.
+InputDistribution inputDistribution = INPUT_RANDOM;
+uint64_t randomSeed = 0;    // --seed, or drawn from std::random_device at startup
+Xoshiro256 inputRng;        // Generates every array
+Xoshiro256 shuffleRng;      // Seeds every shuffle (R, and the race's shared shuffle)
+std::string loadPath;          // --load: an array to sort, or a trace to replay
+std::vector<int> loadedInput;  // A loaded array, used instead of a generated one until I, [ ], - or = asks for new input
+
+// The largest value the current input can hold, which the bars are scaled to. A loaded
+// file sets valueRange to its own span; the killer may need more than valueRange.
+int MaxValue() { return MIN_VALUE + (loadedInput.empty() ? InputSpan(inputDistribution, numElements, valueRange) : valueRange) - 1; }
+
+// Restarts both streams, so the same seed replays the same arrays and shuffles.
+void SeedRandom(uint64_t seed) {
+    randomSeed = seed;
+    inputRng = Xoshiro256(seed);
+    shuffleRng = Xoshiro256(~seed);
+}
+
+// Replay State (the trace itself lives on the worker)
+bool replayEnabled = true;        // T toggles between trace replay and live stepping
+bool hardwareCounters = false;    // H reads the CPU counters around every sort
+bool replayPaused = false;
+int replayDirection = 1;          // -1 plays the trace backwards
+
+// --- SNAPSHOTS ---
+// The worker thread hands the renderer copies of its array through a triple buffer.
+// Each snapshot tracks a version per SNAPSHOT_BLOCK elements, so filling a buffer only
+// copies the blocks written since that buffer was last filled, and the renderer only
+// diffs the blocks that changed since the snapshot it applied before.
+const int SNAPSHOT_BLOCK = 1024;
+
+enum WorkerTask { TASK_IDLE, TASK_SHUFFLE, TASK_SORT };
+
+// Stamps every written block with a fresh clock value. Observes the worker's array.
+class BlockVersions : public ArrayObserver {
+public:
+    void resize(size_t n) { versions.assign((n + SNAPSHOT_BLOCK - 1) / SNAPSHOT_BLOCK, 0); onReset(); }
+    void onWrite(int index, int, int) override { versions[index / SNAPSHOT_BLOCK] = ++clock; }
+    void onReset() override { clock++; std::fill(versions.begin(), versions.end(), clock); }
+
+    std::vector<uint64_t> versions;
+
+private:
+    uint64_t clock = 0;
+};
+
+// Counts the reads and writes landing in each of up to HEAT_BUCKETS equal slices of
+// the array, one per pixel column like ColumnBins, so the cost is a few KB at any N.
+// The counters only ever grow (wrapping), so the renderer can diff any two snapshots
+// even when it skipped the ones in between. Observes the worker's array.
+const int HEAT_BUCKETS = WINDOW_WIDTH;
+
+class AccessHeat : public ArrayObserver {
+public:
+    void resize(size_t n) {
+        int buckets = (int)std::min<size_t>(n, HEAT_BUCKETS);
+        if (buckets != (int)reads.size()) { reads.assign(buckets, 0); writes.assign(buckets, 0); }
+        // 32.32 fixed point instead of a division per access; the clamp covers rounding
+        scale = n ? ((uint64_t)buckets << 32) / n + 1 : 0;
+    }
+    void onRead(int begin, int end) override { for (int k = begin; k < end; k++) reads[bucketOf(k)]++; }
+    void onWrite(int index, int, int) override { writes[bucketOf(index)]++; }
+    void onReset() override {}
+
+    std::vector<uint32_t> reads, writes;
+
+private:
+    uint64_t scale = 0;
+    int bucketOf(int k) const { return std::min((int)(((uint64_t)k * scale) >> 32), (int)reads.size() - 1); }
+};
+
+struct SortSnapshot {
+    std::vector<int> values;
+    std::vector<uint64_t> versions;    // Block versions `values` was copied at
+    std::vector<uint32_t> heatReads, heatWrites; // AccessHeat's running counts
+    Highlight marks[MAX_HIGHLIGHTS];
+    int markCount = 0;
+    int sortedBegin = 0, sortedEnd = 0;
+    float progress = 0.0f;
+    WorkerTask task = TASK_IDLE;
+    bool done = false;
+    bool replaying = false;            // A recorded trace is being played back
+    size_t replayPosition = 0, traceSize = 0;
+};
+
+// Lock-free triple buffer: the writer fills back() and publish() swaps it into the
+// middle slot; acquire() swaps the middle slot to the front whenever a newer one is
+// waiting. Neither side ever blocks the other, and the front stays valid until the
+// next acquire().
+template <typename T>
+class TripleBuffer {
+public:
+    T& back() { return slots[backIndex]; }
+    void publish() { backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX_MASK; }
+
+    bool acquire() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+    const T& front() const { return slots[frontIndex]; }
+
+private:
+    static const int INDEX_MASK = 3, FRESH = 4;
+    T slots[3];
+    int backIndex = 0, frontIndex = 1;
+    std::atomic<int> middle{2};
+};
 
 // --- HELPER: BLUE GRADIENT COLOR ---
-void SetBlueGradientColor(SDL_Renderer* renderer, int value, int max_val) {
-    float ratio = (float)value / max_val;
-    Uint8 r = (Uint8)(30 + ratio * 100);
-    Uint8 g = (Uint8)(30 + ratio * 200);
-    Uint8 b = (Uint8)(150 + ratio * 105);
-    SDL_SetRenderDrawColor(renderer, r, g, b, 255);
+SDL_FColor BlueGradientColor(int value, int max_val) {
+    float ratio = std::min((float)value / max_val, 1.0f);
+    return { (30 + ratio * 100) / 255.0f, (30 + ratio * 200) / 255.0f, (150 + ratio * 105) / 255.0f, 1.0f };
 }
 
-// --- HELPER: RENDER PROGRESS BAR ---
-void RenderProgressBar(SDL_Renderer* renderer) {
-    float rawProgress = 0.0f;
-    if (isSorted) {
-        rawProgress = 1.0f;
-    } else {
-        if (currentMode == BUBBLE_SORT || currentMode == SELECTION_SORT || currentMode == INSERTION_SORT) {
-            rawProgress = (float)i / NUM_RECTANGLES;
+// --- COLUMN BINS ---
+// Splits the array into one bucket per pixel column (a bucket is a single element
+// when N fits the window) and keeps each bucket's min, max and sum up to date from
+// the observed writes. A write can only make a min/max stale when it overwrites the
+// extreme value itself; those buckets are rescanned at the next refresh(), so a frame
+// costs O(width) plus the few buckets that actually lost their extreme.
+class ColumnBins : public ArrayObserver {
+public:
+    explicit ColumnBins(const std::vector<int>& values, int maxColumns = WINDOW_WIDTH) : values(values), maxColumns(maxColumns) {}
+
+    void onWrite(int index, int oldValue, int newValue) override {
+        if (stale || index >= elements) return;
+        int b = bucketOf(index);
+        sums[b] += newValue - oldValue;
+        if ((oldValue == maxs[b] && newValue < oldValue) || (oldValue == mins[b] && newValue > oldValue)) markDirty(b);
+        if (newValue > maxs[b]) maxs[b] = newValue;
+        if (newValue < mins[b]) mins[b] = newValue;
+    }
+    void onReset() override { stale = true; }
+
+    // Brings every bucket up to date. Rebuilds from scratch after a reset or resize.
+    void refresh() {
+        int n = values.size();
+        if (stale || n != elements || std::min(n, maxColumns) != columns) { rebuild(); return; }
+        for (int b : dirtyBuckets) { rescan(b); dirty[b] = 0; }
+        dirtyBuckets.clear();
+    }
+
+    int count() const { return columns; }
+    int firstElement(int c) const { return (int)(((long long)c * elements + columns - 1) / columns); }
+    int bucketOf(int k) const { return (int)((long long)k * columns / elements); }
+    int minOf(int c) const { return mins[c]; }
+    int maxOf(int c) const { return maxs[c]; }
+    int meanOf(int c) const { return (int)(sums[c] / (firstElement(c + 1) - firstElement(c))); }
+
+private:
+    const std::vector<int>& values;
+    std::vector<int> mins, maxs;
+    std::vector<long long> sums;
+    std::vector<Uint8> dirty;
+    std::vector<int> dirtyBuckets;
+    int maxColumns;
+    int columns = 0, elements = 0;
+    bool stale = true;
+
+    void markDirty(int b) { if (!dirty[b]) { dirty[b] = 1; dirtyBuckets.push_back(b); } }
+
+    void rescan(int b) {
+        int begin = firstElement(b), end = firstElement(b + 1);
+        int lo = values[begin], hi = values[begin];
+        long long sum = 0;
+        for (int k = begin; k < end; k++) { lo = std::min(lo, values[k]); hi = std::max(hi, values[k]); sum += values[k]; }
+        mins[b] = lo; maxs[b] = hi; sums[b] = sum;
+    }
+
+    void rebuild() {
+        elements = values.size();
+        columns = std::min(elements, maxColumns);
+        mins.resize(columns); maxs.resize(columns); sums.resize(columns);
+        dirty.assign(columns, 0);
+        dirtyBuckets.clear(); dirtyBuckets.reserve(columns);
+        for (int b = 0; b < columns; b++) rescan(b);
+        stale = false;
+    }
+};
+
+// --- BAR GEOMETRY ---
+// All bars live in one persistent vertex buffer. Each pixel column is two quads: a
+// solid bar up to the bucket's minimum and a dimmer band from there up to its maximum
+// (or a single bar at the mean). Every frame only the columns whose heights or colour
+// changed have their vertices rewritten, and only those columns are redrawn, into a
+// persistent render-target texture with a transparent background that is then
+// composited over whatever lies behind the bars. Without render targets every column
+// is drawn straight to the screen instead. By default the bars fill the main view;
+// setArea() places them elsewhere, such as in a race pane.
+enum BarColor : Uint8 { BAR_GRADIENT, BAR_SORTED, BAR_ACTIVE, BAR_MARKER, BAR_WRITE, BAR_NETWORK, BAR_LANE_0 };
+
+const SDL_FColor LANE_COLORS[PARALLEL_LANES] = {
+    {1.0f, 0.63f, 0.16f, 1.0f}, {0.31f, 0.86f, 0.39f, 1.0f}, {0.9f, 0.82f, 0.24f, 1.0f}, {0.78f, 0.47f, 1.0f, 1.0f}
+};
+
+enum ColumnAggregate { AGGREGATE_MIN_MAX, AGGREGATE_MEAN };
+
+class BarGeometry {
+public:
+    BarGeometry() = default;
+    BarGeometry(const BarGeometry&) = delete;
+    BarGeometry& operator=(const BarGeometry&) = delete;
+    ~BarGeometry() { releaseLayer(); }
+
+    void setArea(float left, float width, float bottom, float height) {
+        areaLeft = left; areaWidth = width; areaBottom = bottom; areaHeight = height;
+        columns = -1; // Relayout on the next update
+        releaseLayer();
+    }
+    // After SDL_EVENT_RENDER_TARGETS_RESET the layer's contents are gone.
+    void invalidate() { repaintAll = true; }
+    // Must run before the renderer is destroyed, and after SDL_EVENT_RENDER_DEVICE_RESET.
+    void releaseLayer() {
+        if (layer) SDL_DestroyTexture(layer);
+        layer = nullptr; layerFailed = false; repaintAll = true;
+    }
+
+    void update(const ColumnBins& bins, int maxValue, ColumnAggregate aggregate, int sortedBegin, int sortedEnd, const Highlight* marks, int markCount) {
+        int cols = bins.count();
+        if (cols != columns || maxValue != layoutMaxValue) relayout(cols, maxValue);
+        if (columns == 0) return;
+
+        for (int c = 0; c < columns; c++) {
+            int k = bins.firstElement(c);
+            wantedColor[c] = (k >= sortedBegin && k < sortedEnd) ? BAR_SORTED : BAR_GRADIENT;
+        }
+        // A highlight recolours the whole column containing it; ranges go first
+        int n = bins.firstElement(columns);
+        for (int m = 0; m < markCount; m++) {
+            const Highlight& h = marks[m];
+            if (h.end <= h.index || h.index < 0 || h.end > n) continue;
+            Uint8 color = h.kind == HIGHLIGHT_NETWORK ? BAR_NETWORK : BAR_LANE_0 + (h.kind - HIGHLIGHT_LANE_0) % PARALLEL_LANES;
+            for (int c = bins.bucketOf(h.index); c <= bins.bucketOf(h.end - 1); c++) wantedColor[c] = color;
+        }
+        for (int m = 0; m < markCount; m++) {
+            int k = marks[m].index;
+            if (marks[m].end > k || k < 0 || k >= n) continue;
+            int c = bins.bucketOf(k);
+            switch (marks[m].kind) {
+                case HIGHLIGHT_ACTIVE: wantedColor[c] = BAR_ACTIVE; break;
+                case HIGHLIGHT_MARKER: wantedColor[c] = BAR_MARKER; break;
+                case HIGHLIGHT_WRITE: wantedColor[c] = BAR_WRITE; break;
+                default: break;
+            }
+        }
+
+        for (int c = 0; c < columns; c++) {
+            int low, high;
+            if (aggregate == AGGREGATE_MEAN) low = high = bins.meanOf(c);
+            else { low = bins.minOf(c); high = bins.maxOf(c); }
+            if (low == shownLow[c] && high == shownHigh[c] && wantedColor[c] == shownColor[c]) continue;
+            shownLow[c] = low; shownHigh[c] = high; shownColor[c] = wantedColor[c];
+            writeColumn(c, low, high, wantedColor[c]);
+            dirtyColumns.push_back(c);
+        }
+    }
+
+    void draw(SDL_Renderer* renderer) {
+        if (columns <= 0) return;
+        if (!layer && !layerFailed) createLayer(renderer);
+        SDL_Rect area = {(int)areaLeft, (int)(areaBottom - areaHeight), (int)std::ceil(areaWidth), (int)std::ceil(areaHeight)};
+        if (!layer) {
+            SDL_SetRenderViewport(renderer, &area);
+            SDL_RenderGeometry(renderer, nullptr, vertices.data(), vertices.size(), indices.data(), indices.size());
+            SDL_SetRenderViewport(renderer, nullptr);
+            dirtyColumns.clear();
+            return;
+        }
+        if (repaintAll || !dirtyColumns.empty()) repaint(renderer);
+        SDL_FRect target = {(float)area.x, (float)area.y, (float)area.w, (float)area.h};
+        SDL_RenderTexture(renderer, layer, nullptr, &target);
+    }
+
+private:
+    std::vector<SDL_Vertex> vertices;  // 8 per column: the solid quad, then the range quad
+    std::vector<int> indices;          // 12 per column, two triangles per quad
+    std::vector<int> shownLow, shownHigh;  // What each column currently displays
+    std::vector<Uint8> shownColor;
+    std::vector<Uint8> wantedColor;
+    std::vector<int> dirtyColumns;     // Rewritten since the layer was last drawn to
+    std::vector<int> dirtyIndices;
+    std::vector<SDL_FRect> dirtyRects;
+    SDL_Texture* layer = nullptr;
+    bool layerFailed = false, repaintAll = true;
+    int columns = 0, layoutMaxValue = 0;
+    float areaLeft = 0.0f, areaWidth = WINDOW_WIDTH, areaBottom = BAR_BOTTOM_Y, areaHeight = MAX_BAR_HEIGHT;
+    float barWidth = 0.0f, gap = 0.0f, heightScale = 0.0f;
+
+    void createLayer(SDL_Renderer* renderer) {
+        layer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, (int)std::ceil(areaWidth), (int)std::ceil(areaHeight));
+        layerFailed = layer == nullptr;
+        if (!layer) return;
+        SDL_SetTextureBlendMode(layer, SDL_BLENDMODE_BLEND);
+        SDL_SetTextureScaleMode(layer, SDL_SCALEMODE_NEAREST);
+        repaintAll = true;
+    }
+
+    // Clears the dirty columns to transparent and draws just their quads into the layer.
+    void repaint(SDL_Renderer* renderer) {
+        SDL_Texture* previous = SDL_GetRenderTarget(renderer);
+        SDL_SetRenderTarget(renderer, layer);
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+        if (repaintAll) {
+            SDL_RenderClear(renderer);
+            SDL_RenderGeometry(renderer, nullptr, vertices.data(), vertices.size(), indices.data(), indices.size());
         } else {
-            int sortedPairs = 0;
-            int totalPairs = data.size() > 1 ? data.size() - 1 : 1;
-            for (size_t k = 0; k < data.size() - 1; ++k) {
-                if (data[k] <= data[k+1]) sortedPairs++;
+            dirtyRects.clear(); dirtyIndices.clear();
+            for (int c : dirtyColumns) {
+                dirtyRects.push_back({c * barWidth, 0.0f, barWidth, areaHeight});
+                dirtyIndices.insert(dirtyIndices.end(), indices.begin() + c * 12, indices.begin() + c * 12 + 12);
             }
-            rawProgress = (float)sortedPairs / totalPairs;
+            SDL_RenderFillRects(renderer, dirtyRects.data(), dirtyRects.size());
+            SDL_RenderGeometry(renderer, nullptr, vertices.data(), vertices.size(), dirtyIndices.data(), dirtyIndices.size());
         }
+        SDL_SetRenderTarget(renderer, previous);
+        dirtyColumns.clear();
+        repaintAll = false;
+    }
+
+    void relayout(int cols, int maxValue) {
+        columns = cols; layoutMaxValue = maxValue;
+        barWidth = cols ? areaWidth / cols : 0.0f;
+        gap = barWidth > 2.0f ? 1.0f : 0.0f;
+        heightScale = areaHeight / maxValue;
+
+        vertices.assign(cols * 8, SDL_Vertex{});
+        indices.resize(cols * 12);
+        const int quad[6] = {0, 1, 2, 2, 3, 0};
+        for (int q = 0; q < cols * 2; q++)
+            for (int v = 0; v < 6; v++) indices[q * 6 + v] = q * 4 + quad[v];
+        shownLow.assign(cols, -1);      // Forces every column to be written on the next update
+        shownHigh.assign(cols, -1);
+        shownColor.assign(cols, BAR_GRADIENT);
+        wantedColor.assign(cols, BAR_GRADIENT);
+        dirtyColumns.clear(); dirtyColumns.reserve(cols);
+        dirtyRects.reserve(cols); dirtyIndices.reserve(cols * 12);
+        repaintAll = true;
     }
-    if (rawProgress > currentMaxProgress) currentMaxProgress = rawProgress;
-    if (comparisons == 0 && !isSorted) currentMaxProgress = 0.0f;
+
+    static void writeQuad(SDL_Vertex* v, float x0, float x1, float top, float bottom, SDL_FColor fill) {
+        v[0] = {{x0, top}, fill, {0, 0}};
+        v[1] = {{x1, top}, fill, {0, 0}};
+        v[2] = {{x1, bottom}, fill, {0, 0}};
+        v[3] = {{x0, bottom}, fill, {0, 0}};
+    }
+
+    void writeColumn(int c, int low, int high, Uint8 color) {
+        SDL_FColor lowFill, highFill;
+        switch (color) {
+            case BAR_ACTIVE: lowFill = highFill = {1.0f, 50 / 255.0f, 50 / 255.0f, 1.0f}; break;
+            case BAR_MARKER: lowFill = highFill = {1.0f, 0.0f, 1.0f, 1.0f}; break;
+            case BAR_SORTED: case BAR_WRITE: lowFill = highFill = {1.0f, 1.0f, 1.0f, 1.0f}; break;
+            case BAR_NETWORK:
+                lowFill = {0.2f, 0.9f, 0.95f, 1.0f};
+                highFill = {0.11f, 0.5f, 0.52f, 1.0f};
+                break;
+            case BAR_GRADIENT:
+                lowFill = BlueGradientColor(low, layoutMaxValue);
+                highFill = BlueGradientColor(high, layoutMaxValue);
+                highFill.r *= 0.55f; highFill.g *= 0.55f; highFill.b *= 0.55f;
+                break;
+            default:
+                lowFill = LANE_COLORS[(color - BAR_LANE_0) % PARALLEL_LANES];
+                highFill = {lowFill.r * 0.55f, lowFill.g * 0.55f, lowFill.b * 0.55f, 1.0f};
+                break;
+        }
+        // Relative to the bar area: the layer, or the viewport when drawing directly
+        float x0 = c * barWidth, x1 = x0 + barWidth - gap;
+        float lowTop = areaHeight - low * heightScale;
+        float highTop = areaHeight - high * heightScale;
+        writeQuad(&vertices[c * 8], x0, x1, lowTop, areaHeight, lowFill);
+        writeQuad(&vertices[c * 8 + 4], x0, x1, highTop, lowTop, highFill);
+    }
+};
+
+ColumnBins columnBins(data);
+ColumnAggregate columnAggregate = AGGREGATE_MIN_MAX; // G toggles min/max vs mean columns
+
+// --- ACCESS HEATMAP ---
+// M draws where the sort reads and writes as a glow behind the bars, built from the
+// worker's per-column AccessHeat counts. Each frame adds the accesses since the last
+// snapshot and decays the older heat with a half-life of HEAT_HALF_LIFE_SECONDS.
+// Columns blend from amber (reads) to red (writes), and their opacity grows with the
+// square root of their share of the hottest column, so lukewarm ranges stay visible.
+const double HEAT_HALF_LIFE_SECONDS = 0.4;
+const float HEAT_MAX_ALPHA = 0.6f;
+
+class HeatmapLayer {
+public:
+    void update(const std::vector<uint32_t>& reads, const std::vector<uint32_t>& writes, double seconds) {
+        int columns = reads.size();
+        if (columns != (int)readHeat.size() || writes.size() != reads.size()) { relayout(columns); lastReads = reads; lastWrites = writes; return; }
+        float decay = (float)std::exp2(-seconds / HEAT_HALF_LIFE_SECONDS);
+        float peak = 0.0f;
+        for (int c = 0; c < columns; c++) {
+            readHeat[c] = readHeat[c] * decay + (uint32_t)(reads[c] - lastReads[c]);
+            writeHeat[c] = writeHeat[c] * decay + (uint32_t)(writes[c] - lastWrites[c]);
+            peak = std::max(peak, readHeat[c] + writeHeat[c]);
+        }
+        std::copy(reads.begin(), reads.end(), lastReads.begin());
+        std::copy(writes.begin(), writes.end(), lastWrites.begin());
+
+        float width = (float)WINDOW_WIDTH / std::max(columns, 1);
+        for (int c = 0; c < columns; c++) {
+            float total = readHeat[c] + writeHeat[c];
+            float writeShare = total > 0.0f ? writeHeat[c] / total : 0.0f;
+            float alpha = peak > 0.0f ? std::sqrt(total / peak) * HEAT_MAX_ALPHA : 0.0f;
+            SDL_FColor fill = {1.0f, 0.72f - 0.5f * writeShare, 0.2f, alpha};
+            float x0 = c * width, x1 = x0 + width, top = BAR_BOTTOM_Y - MAX_BAR_HEIGHT;
+            SDL_Vertex* v = &vertices[c * 4];
+            v[0] = {{x0, top}, fill, {0, 0}};
+            v[1] = {{x1, top}, fill, {0, 0}};
+            v[2] = {{x1, BAR_BOTTOM_Y}, fill, {0, 0}};
+            v[3] = {{x0, BAR_BOTTOM_Y}, fill, {0, 0}};
+        }
+    }
+
+    void draw(SDL_Renderer* renderer) const {
+        if (vertices.empty()) return;
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+        SDL_RenderGeometry(renderer, nullptr, vertices.data(), vertices.size(), indices.data(), indices.size());
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    }
+
+private:
+    std::vector<float> readHeat, writeHeat;
+    std::vector<uint32_t> lastReads, lastWrites;
+    std::vector<SDL_Vertex> vertices; // 4 per column
+    std::vector<int> indices;
+
+    void relayout(int columns) {
+        readHeat.assign(columns, 0.0f); writeHeat.assign(columns, 0.0f);
+        vertices.assign(columns * 4, SDL_Vertex{});
+        indices.resize(columns * 6);
+        const int quad[6] = {0, 1, 2, 2, 3, 0};
+        for (int c = 0; c < columns; c++)
+            for (int v = 0; v < 6; v++) indices[c * 6 + v] = c * 4 + quad[v];
+    }
+};
+
+HeatmapLayer heatmap;
+bool showHeatmap = false; // M toggles the access heatmap
+
+// --- SORTEDNESS TRACKING ---
+// Number of adjacent pairs already in order, kept exact in O(1) per observed write
+// by re-evaluating only the two pairs that touch the written index.
+class SortednessTracker : public ArrayObserver {
+public:
+    explicit SortednessTracker(const std::vector<int>& values) : values(values) {}
+
+    void onWrite(int k, int oldValue, int newValue) override {
+        if (stale) return;
+        if (k > 0) sortedPairs += (values[k-1] <= newValue) - (values[k-1] <= oldValue);
+        if (k + 1 < (int)values.size()) sortedPairs += (newValue <= values[k+1]) - (oldValue <= values[k+1]);
+    }
+    void onReset() override { stale = true; }
+
+    // Recounts from scratch, but only after a reset.
+    void refresh() {
+        if (!stale) return;
+        sortedPairs = 0;
+        for (size_t k = 1; k < values.size(); k++) sortedPairs += values[k-1] <= values[k];
+        stale = false;
+    }
+
+    long long pairs() const { return values.size() > 1 ? values.size() - 1 : 0; }
+    long long sorted() const { return sortedPairs; }
+    float fraction() const { return pairs() ? (float)sortedPairs / pairs() : 1.0f; }
+
+private:
+    const std::vector<int>& values;
+    long long sortedPairs = 0;
+    bool stale = true;
+};
+
+// Global inversion count via a Fenwick tree over value ranks. Sorting only permutes
+// the values, so the ranks are computed once per reset. A full count is O(N log N),
+// so it is spread over frames (INVERSION_SLICE elements each) and the last completed
+// pass is reported; while the array changes mid-pass the count is approximate.
+const int INVERSION_SLICE = 1 << 16;
+
+class InversionCounter : public ArrayObserver {
+public:
+    explicit InversionCounter(const std::vector<int>& values) : values(values) {}
+
+    void onWrite(int, int, int) override {}
+    void onReset() override { stale = true; }
+
+    void advance() {
+        if (stale) rebuild();
+        int n = values.size();
+        int end = std::min(n, passPos + INVERSION_SLICE);
+        for (; passPos < end; passPos++) {
+            int r = rankOf(values[passPos]);
+            passInversions += passPos - prefix(r); // Earlier elements greater than this one
+            for (int x = r + 1; x < (int)tree.size(); x += x & -x) tree[x]++;
+        }
+        if (passPos == n) {
+            inversions = passInversions;
+            if (initialInversions < 0) initialInversions = inversions;
+            startPass();
+        }
+    }
+
+    long long count() const { return inversions; }
+    // 1 when no inversions are left, 0 at the inversion count the sort started from.
+    float fraction() const {
+        if (inversions < 0) return 0.0f;
+        return initialInversions > 0 ? 1.0f - (float)inversions / initialInversions : 1.0f;
+    }
+
+private:
+    const std::vector<int>& values;
+    std::vector<int> ranks;     // Sorted distinct values
+    std::vector<int> tree;      // Fenwick tree, 1-based
+    int passPos = 0;
+    long long passInversions = 0;
+    long long inversions = -1, initialInversions = -1;
+    bool stale = true;
+
+    int rankOf(int v) const { return std::lower_bound(ranks.begin(), ranks.end(), v) - ranks.begin(); }
+    // Number of counted elements with rank <= r
+    int prefix(int r) const { int sum = 0; for (int x = r + 1; x > 0; x -= x & -x) sum += tree[x]; return sum; }
+
+    void startPass() { std::fill(tree.begin(), tree.end(), 0); passPos = 0; passInversions = 0; }
+
+    void rebuild() {
+        ranks.assign(values.begin(), values.end());
+        std::sort(ranks.begin(), ranks.end());
+        ranks.erase(std::unique(ranks.begin(), ranks.end()), ranks.end());
+        tree.assign(ranks.size() + 1, 0);
+        inversions = initialInversions = -1;
+        startPass();
+        stale = false;
+    }
+};
+
+SortednessTracker sortedness(data);
+InversionCounter inversionCounter(data);
+ArrayObserverList displayObservers; // Everything derived from `data` for display
+
+// P cycles what the progress bar shows
+enum ProgressMetric { PROGRESS_ALGORITHM, PROGRESS_SORTED_PAIRS, PROGRESS_INVERSIONS };
+ProgressMetric progressMetric = PROGRESS_ALGORITHM;
+
+// --- HELPER: RENDER PROGRESS BAR ---
+void RenderProgressBar(SDL_Renderer* renderer, const SortSnapshot& view, unsigned long long comparisons) {
+    float rawProgress = 0.0f;
+    if (isSorted) rawProgress = 1.0f;
+    else if (!isShuffling) {
+        switch (progressMetric) {
+            case PROGRESS_ALGORITHM: rawProgress = view.progress; break;
+            case PROGRESS_SORTED_PAIRS: rawProgress = sortedness.fraction(); break;
+            case PROGRESS_INVERSIONS: rawProgress = inversionCounter.fraction(); break;
+        }
+    }
+    if (rawProgress > currentMaxProgress || view.replaying) currentMaxProgress = rawProgress; // Replays can scrub backwards
+    if ((isShuffling || comparisons == 0) && !isSorted) currentMaxProgress = 0.0f;
 
     float barHeight = 25.0f;
     float barY = WINDOW_HEIGHT - barHeight;
@@ -110,90 +1232,1781 @@ void RenderProgressBar(SDL_Renderer* renderer) {
 }
 
 // --- AUDIO CALLBACK ---
+// Mixes tone events into a small bank of exponentially decaying voices. Everything
+// the callback touches is preallocated, so the real-time thread never allocates.
+class AudioMixer {
+public:
+    void render(SDL_AudioStream* stream, int samplesWanted) {
+        Uint64 freq = SDL_GetPerformanceFrequency();
+        Uint64 latency = (Uint64)(AUDIO_LATENCY_SECONDS * freq);
+        Uint64 now = SDL_GetPerformanceCounter();
+        // Audio time runs AUDIO_LATENCY_SECONDS behind the wall clock; resync if it drifted a latency away
+        Uint64 target = now > latency ? now - latency : 0;
+        // Falling a whole latency behind means the callback came too late and the device ran dry
+        if (cursor != 0 && cursor + latency < target) underruns.fetch_add(1, std::memory_order_relaxed);
+        if (cursor > now || cursor + latency < target) cursor = target;
+        double ticksPerSample = (double)freq / SAMPLE_RATE;
+
+        while (samplesWanted > 0) {
+            int count = std::min(samplesWanted, AUDIO_CHUNK);
+            for (int k = 0; k < count; k++) {
+                Uint64 sampleTick = cursor + (Uint64)(k * ticksPerSample);
+                while (const ToneEvent* e = toneEvents.peek()) {
+                    if (e->tick > sampleTick) break;
+                    startVoice(e->pitch);
+                    toneEvents.pop();
+                }
+                float mixed = 0.0f;
+                int active = 0;
+                for (Voice& v : voices) {
+                    if (v.amplitude < 0.001f) continue;
+                    mixed += v.amplitude * (float)std::sin(v.phase);
+                    v.phase += v.increment;
+                    if (v.phase >= 2.0 * M_PI) v.phase -= 2.0 * M_PI;
+                    v.amplitude *= decay;
+                    active++;
+                }
+                // Dividing by sqrt(active) keeps dense passages about as loud as a single tone
+                mixBuffer[k] = active ? VOLUME * mixed / std::sqrt((float)active) : 0.0f;
+            }
+            cursor += (Uint64)(count * ticksPerSample);
+            SDL_PutAudioStreamData(stream, mixBuffer, count * sizeof(float));
+            samplesWanted -= count;
+        }
+    }
+
+    std::atomic<unsigned> underruns{0};
+
+private:
+    struct Voice {
+        double phase = 0.0;
+        double increment = 0.0;
+        float amplitude = 0.0f;
+    };
+
+    Voice voices[MAX_VOICES];
+    float mixBuffer[AUDIO_CHUNK];
+    Uint64 cursor = 0;   // Performance-counter time of the next sample to be rendered
+    float decay = (float)std::exp(-1.0 / (TONE_DECAY_SECONDS * SAMPLE_RATE));
+
+    // Takes a silent voice, or steals the quietest one.
+    void startVoice(float pitch) {
+        if (pitch <= 0.0f) return;
+        Voice* quietest = &voices[0];
+        for (Voice& v : voices) if (v.amplitude < quietest->amplitude) quietest = &v;
+        double frequency = 200.0 + pitch * 830.0;
+        quietest->increment = (2.0 * M_PI * frequency) / SAMPLE_RATE;
+        quietest->amplitude = 1.0f;
+    }
+};
+
+AudioMixer audioMixer;
+
 void SDLCALL AudioCallback(void *userdata, SDL_AudioStream *stream, int additional_amount, int total_amount) {
     if (additional_amount <= 0) return;
-    std::vector<float> buffer(additional_amount / sizeof(float));
-    static double phase = 0.0;
+    static_cast<AudioMixer*>(userdata)->render(stream, additional_amount / sizeof(float));
+}
 
-    for (size_t k = 0; k < buffer.size(); k++) {
-        int h = targetHeight.load();
-        double frequency = (h <= 0) ? 0.0 : (200.0 + (h * 8.0));
-        buffer[k] = (frequency > 0) ? (VOLUME * std::sin(phase)) : 0.0f;
-        double phaseIncrement = (2.0 * M_PI * frequency) / SAMPLE_RATE;
-        phase += phaseIncrement;
-        if (phase >= 2.0 * M_PI) phase -= 2.0 * M_PI;
+// --- HELPER: TEXT BUFFER ---
+// Fixed-capacity text formatted with std::to_chars, so building the overlay every
+// frame allocates nothing. Anything past the capacity is dropped. Doubles print in
+// fixed notation with precision() digits.
+struct Fixed { double value; int digits; };  // A double with its own digit count
+struct HumanCount { double value; };         // 1234567 -> "1.23M"
+struct HumanBytes { double value; };         // 1536 -> "1.5 KB"
+
+class TextBuffer {
+public:
+    static const size_t CAPACITY = 2048;
+
+    std::string_view view() const { return {chars, length}; }
+    void clear() { length = 0; }
+    TextBuffer& precision(int digits) { defaultDigits = digits; return *this; }
+
+    TextBuffer& operator<<(std::string_view s) {
+        size_t count = std::min(s.size(), CAPACITY - length);
+        std::memcpy(chars + length, s.data(), count);
+        length += count;
+        return *this;
     }
-    SDL_PutAudioStreamData(stream, buffer.data(), buffer.size() * sizeof(float));
-}
+    TextBuffer& operator<<(const char* s) { return *this << std::string_view(s); }
+    TextBuffer& operator<<(char c) { if (length < CAPACITY) chars[length++] = c; return *this; }
+    template <typename Int, std::enable_if_t<std::is_integral_v<Int>, int> = 0>
+    TextBuffer& operator<<(Int v) { return put(std::to_chars(chars + length, chars + CAPACITY, v)); }
+    TextBuffer& operator<<(double v) { return *this << Fixed{v, defaultDigits}; }
+    TextBuffer& operator<<(Fixed f) { return put(std::to_chars(chars + length, chars + CAPACITY, f.value, std::chars_format::fixed, f.digits)); }
+    TextBuffer& operator<<(HumanCount c) {
+        const char* suffixes[] = {"", "K", "M", "G", "T"};
+        int s = 0;
+        while (c.value >= 1000.0 && s < 4) { c.value /= 1000.0; s++; }
+        return *this << Fixed{c.value, s ? 2 : 0} << suffixes[s];
+    }
+    TextBuffer& operator<<(HumanBytes b) {
+        const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+        int u = 0;
+        while (b.value >= 1024.0 && u < 4) { b.value /= 1024.0; u++; }
+        return *this << Fixed{b.value, u ? 1 : 0} << ' ' << units[u];
+    }
+
+private:
+    char chars[CAPACITY];
+    size_t length = 0;
+    int defaultDigits = 3;
+
+    TextBuffer& put(std::to_chars_result r) { if (r.ec == std::errc()) length = r.ptr - chars; return *this; }
+};
 
 // --- HELPER: RENDER UI ---
-void RenderUI(SDL_Renderer* renderer, std::string fullText) {
-    SDL_SetRenderScale(renderer, TEXT_SCALE, TEXT_SCALE);
 
-    float startX = 20.0f / TEXT_SCALE;
-    float currentY = 20.0f / TEXT_SCALE;
+const float DEBUG_GLYPH_SIZE = 8.0f; // SDL_RenderDebugText draws 8x8 pixel glyphs
+const float TEXT_SHADOW = 2.0f;
 
-    std::stringstream ss(fullText);
-    std::string line;
+// Draws each line twice (shadow, then text) and returns the height used, in window
+// pixels. Lines are walked in place and copied into a stack buffer for the
+// NUL-terminated debug text call, so nothing is allocated.
+float RenderUI(SDL_Renderer* renderer, std::string_view fullText, float x = 20.0f, float y = 20.0f) {
+    SDL_SetRenderScale(renderer, TEXT_SCALE, TEXT_SCALE);
+
+    float startX = x / TEXT_SCALE;
+    float currentY = y / TEXT_SCALE;
+    char line[256];
 
-    while (std::getline(ss, line, '\n')) {
-        if (line.empty()) {
+    while (!fullText.empty()) {
+        size_t end = std::min(fullText.find('\n'), fullText.size());
+        std::string_view text = fullText.substr(0, end);
+        fullText.remove_prefix(std::min(end + 1, fullText.size()));
+        if (text.empty()) {
             currentY += LINE_HEIGHT / 2;
             continue;
         }
+        size_t length = std::min(text.size(), sizeof(line) - 1);
+        std::memcpy(line, text.data(), length);
+        line[length] = '\0';
 
         // Shadow
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-        SDL_RenderDebugText(renderer, startX + 2, currentY + 2, line.c_str());
+        SDL_RenderDebugText(renderer, startX + TEXT_SHADOW, currentY + TEXT_SHADOW, line);
 
         // Text Color
-        if (line.find(':') != std::string::npos) {
+        if (text.find(':') != std::string_view::npos) {
             SDL_SetRenderDrawColor(renderer, 100, 255, 255, 255);
         } else {
             SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
         }
 
-        SDL_RenderDebugText(renderer, startX, currentY, line.c_str());
+        SDL_RenderDebugText(renderer, startX, currentY, line);
         currentY += LINE_HEIGHT;
     }
 
     SDL_SetRenderScale(renderer, 1.0f, 1.0f);
+    return currentY * TEXT_SCALE - y;
 }
 
-// --- LOGIC: RESET / PREPARE ---
-void PrepareForSort() {
-    isSorted = false; isShuffling = false;
-    comparisons = 0; swaps = 0;
+// Text that rarely changes (the algorithm header) is rendered once into a texture and
+// blitted every frame after that; it is only drawn again when the text changes, or
+// when the texture's contents are lost. Without render targets it falls back to
+// RenderUI.
+class CachedText {
+public:
+    CachedText() = default;
+    CachedText(const CachedText&) = delete;
+    CachedText& operator=(const CachedText&) = delete;
+    ~CachedText() { release(); }
+
+    // Returns the height used, like RenderUI.
+    float draw(SDL_Renderer* renderer, std::string_view text, float x, float y) {
+        if (text != shown || !texture) rebuild(renderer, text);
+        if (!texture) return RenderUI(renderer, text, x, y);
+        SDL_FRect source = {0.0f, 0.0f, width, height}, target = {x, y, width, height};
+        SDL_RenderTexture(renderer, texture, &source, &target);
+        return advance;
+    }
+    void invalidate() { shown.clear(); } // After SDL_EVENT_RENDER_TARGETS_RESET
+    void release() {                     // Before the renderer goes, or after a device reset
+        if (texture) SDL_DestroyTexture(texture);
+        texture = nullptr; failed = false; shown.clear();
+    }
+
+private:
+    SDL_Texture* texture = nullptr;
+    std::string shown;
+    bool failed = false;
+    float width = 0.0f, height = 0.0f, advance = 0.0f;
+    int capacityWidth = 0, capacityHeight = 0;
+
+    void rebuild(SDL_Renderer* renderer, std::string_view text) {
+        if (failed) return;
+        size_t longest = 0;
+        for (size_t start = 0; start <= text.size();) {
+            size_t end = std::min(text.find('\n', start), text.size());
+            longest = std::max(longest, end - start);
+            start = end + 1;
+        }
+        width = std::ceil((longest * DEBUG_GLYPH_SIZE + TEXT_SHADOW) * TEXT_SCALE);
+        height = std::ceil((std::count(text.begin(), text.end(), '\n') + 1) * LINE_HEIGHT * TEXT_SCALE);
+        if (!texture || width > capacityWidth || height > capacityHeight) {
+            if (texture) SDL_DestroyTexture(texture);
+            capacityWidth = std::max((int)width, 1); capacityHeight = std::max((int)height, 1);
+            texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, capacityWidth, capacityHeight);
+            if (!texture) { failed = true; return; }
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+            SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_NEAREST);
+        }
+        SDL_Texture* previous = SDL_GetRenderTarget(renderer);
+        SDL_SetRenderTarget(renderer, texture);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+        SDL_RenderClear(renderer);
+        advance = RenderUI(renderer, text, 0.0f, 0.0f);
+        SDL_SetRenderTarget(renderer, previous);
+        shown.assign(text);
+    }
+};
+
+// --- FRAME PROFILER ---
+// Times the phases of each main-loop frame with the performance counter and keeps the
+// last FRAME_HISTORY frames. F shows them as an overlay (per-phase averages, frame-time
+// percentiles and a histogram); Shift+F writes them as a Chrome trace, which loads in
+// chrome://tracing or Perfetto. Everything is preallocated, so profiling a frame
+// doesn't allocate either.
+enum FramePhase { PHASE_EVENTS, PHASE_STEPPING, PHASE_GEOMETRY, PHASE_UI, PHASE_PRESENT, NUM_FRAME_PHASES };
+const char* const FRAME_PHASE_NAMES[NUM_FRAME_PHASES] = {"events", "stepping", "geometry", "ui text", "present"};
+const int FRAME_HISTORY = 600;           // Ten seconds at 60 Hz
+const int FRAME_HISTOGRAM_BINS = 40;
+const double FRAME_HISTOGRAM_MS = 40.0;  // The last bin collects everything slower
+const float PROFILE_OVERLAY_WIDTH = 440.0f;
+
+class FrameProfiler {
+public:
+    void beginFrame() {
+        current = Frame{};
+        current.start = last = SDL_GetPerformanceCounter();
+    }
+    // Charges the time since the previous mark to `phase`, so the phases add up to the frame
+    void mark(FramePhase phase) {
+        Uint64 now = SDL_GetPerformanceCounter();
+        current.phaseTicks[phase] += now - last;
+        last = now;
+    }
+    void endFrame(double stepsPerSecond, unsigned underruns) {
+        current.stepsPerSecond = stepsPerSecond;
+        current.underruns = underruns;
+        Frame& slot = frames[next];
+        if (count == FRAME_HISTORY) forget(slot);
+        else count++;
+        slot = current;
+        for (int p = 0; p < NUM_FRAME_PHASES; p++) phaseSums[p] += slot.phaseTicks[p];
+        histogram[HistogramBin(slot.total())]++;
+        next = (next + 1) % FRAME_HISTORY;
+    }
+
+    void draw(SDL_Renderer* renderer, float x, float y) {
+        if (count == 0) return;
+        double msPerTick = 1000.0 / SDL_GetPerformanceFrequency();
+        for (int k = 0; k < count; k++) sortedMs[k] = frames[k].total() * msPerTick;
+        auto percentile = [&](double q) {
+            double* nth = sortedMs + std::min((int)(q * count), count - 1);
+            std::nth_element(sortedMs, nth, sortedMs + count);
+            return *nth;
+        };
+        const Frame& latest = frames[(next + FRAME_HISTORY - 1) % FRAME_HISTORY];
+
+        TextBuffer text;
+        text << "PROFILE: " << count << " frames, avg ms\n";
+        for (int p = 0; p < NUM_FRAME_PHASES; p++) {
+            text << FRAME_PHASE_NAMES[p];
+            for (size_t pad = std::strlen(FRAME_PHASE_NAMES[p]); pad < 10; pad++) text << ' ';
+            text << Fixed{phaseSums[p] * msPerTick / count, 2} << "\n";
+        }
+        text << "p50/95/99: " << Fixed{percentile(0.50), 1} << ' ' << Fixed{percentile(0.95), 1} << ' ' << Fixed{percentile(0.99), 1} << "\n"
+             << "steps/s:   " << HumanCount{latest.stepsPerSecond} << "\n"
+             << "underruns: " << latest.underruns << "\n";
+        float height = RenderUI(renderer, text.view(), x, y);
+
+        // Frame-time histogram, 0..FRAME_HISTOGRAM_MS left to right
+        float barWidth = PROFILE_OVERLAY_WIDTH / FRAME_HISTOGRAM_BINS, chartHeight = 80.0f, top = y + height + 8.0f;
+        int tallest = *std::max_element(histogram, histogram + FRAME_HISTOGRAM_BINS);
+        SDL_FRect bars[FRAME_HISTOGRAM_BINS];
+        for (int b = 0; b < FRAME_HISTOGRAM_BINS; b++) {
+            float h = chartHeight * histogram[b] / std::max(tallest, 1);
+            bars[b] = {x + b * barWidth, top + chartHeight - h, barWidth - 1.0f, h};
+        }
+        SDL_FRect frame = {x, top, PROFILE_OVERLAY_WIDTH, chartHeight};
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 160);
+        SDL_RenderFillRect(renderer, &frame);
+        SDL_SetRenderDrawColor(renderer, 100, 255, 255, 255);
+        SDL_RenderFillRects(renderer, bars, FRAME_HISTOGRAM_BINS);
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    }
+
+    // Complete ("X") events for every frame and its phases, with counter ("C") events for
+    // the step rate and underruns; timestamps are microseconds from the oldest frame.
+    bool writeTrace(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out) return false;
+        double usPerTick = 1e6 / SDL_GetPerformanceFrequency();
+        int oldest = count == FRAME_HISTORY ? next : 0;
+        Uint64 origin = frames[oldest].start;
+        out << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n"
+            << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"main loop\"}}";
+        for (int k = 0; k < count; k++) {
+            const Frame& f = frames[(oldest + k) % FRAME_HISTORY];
+            auto event = [&](const char* name, Uint64 begin, Uint64 ticks) {
+                out << ",\n  {\"name\": \"" << name << "\", \"cat\": \"frame\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": "
+                    << (begin - origin) * usPerTick << ", \"dur\": " << ticks * usPerTick << "}";
+            };
+            event("frame", f.start, f.total());
+            Uint64 phaseStart = f.start;
+            for (int p = 0; p < NUM_FRAME_PHASES; p++) {
+                if (f.phaseTicks[p]) event(FRAME_PHASE_NAMES[p], phaseStart, f.phaseTicks[p]);
+                phaseStart += f.phaseTicks[p];
+            }
+            out << ",\n  {\"name\": \"sorting\", \"ph\": \"C\", \"pid\": 1, \"tid\": 1, \"ts\": " << (f.start - origin) * usPerTick
+                << ", \"args\": {\"steps_per_second\": " << f.stepsPerSecond << ", \"audio_underruns\": " << f.underruns << "}}";
+        }
+        out << "\n]}\n";
+        return (bool)out;
+    }
+
+private:
+    struct Frame {
+        Uint64 start = 0;
+        Uint64 phaseTicks[NUM_FRAME_PHASES] = {};
+        double stepsPerSecond = 0.0;
+        unsigned underruns = 0;
+        Uint64 total() const { Uint64 sum = 0; for (Uint64 t : phaseTicks) sum += t; return sum; }
+    };
+
+    Frame frames[FRAME_HISTORY];
+    Frame current;
+    int next = 0, count = 0;              // Ring position and fill
+    Uint64 last = 0;
+    Uint64 phaseSums[NUM_FRAME_PHASES] = {};
+    int histogram[FRAME_HISTOGRAM_BINS] = {};
+    double sortedMs[FRAME_HISTORY];       // Scratch for the percentiles
+
+    static int HistogramBin(Uint64 ticks) {
+        double ms = ticks * 1000.0 / SDL_GetPerformanceFrequency();
+        return std::clamp((int)(ms * FRAME_HISTOGRAM_BINS / FRAME_HISTOGRAM_MS), 0, FRAME_HISTOGRAM_BINS - 1);
+    }
+    void forget(const Frame& f) {
+        for (int p = 0; p < NUM_FRAME_PHASES; p++) phaseSums[p] -= f.phaseTicks[p];
+        histogram[HistogramBin(f.total())]--;
+    }
+};
+
+FrameProfiler profiler;
+bool showProfiler = false;                    // F toggles the profiling overlay
+std::string frameTracePath = "frame_trace.json"; // Shift+F writes the trace here (--frame-trace)
+
+// --- LOGIC: STEP RUNNER ---
+// Calls stepOnce(sound) up to `steps` times, stopping early when it returns false.
+// The steps are split into at most MAX_TONES_PER_SLICE chunks; the last value each
+// chunk touched becomes a tone stamped at the chunk's share of [fromTick, toTick]. A
+// pitchScale of 0 runs silently.
+template <typename StepFn>
+int RunScheduledSteps(int steps, Uint64 fromTick, Uint64 toTick, float pitchScale, StepFn&& stepOnce) {
+    int chunk = std::max(1, (steps + MAX_TONES_PER_SLICE - 1) / MAX_TONES_PER_SLICE);
+    int done = 0;
+    bool more = true;
+    while (more && done < steps) {
+        int end = std::min(steps, done + chunk);
+        int sound = 0;
+        for (; done < end; done++) if (!stepOnce(sound)) { more = false; break; }
+        if (sound > 0 && pitchScale > 0.0f) PushTone(fromTick + (toTick - fromTick) * done / steps, sound * pitchScale);
+    }
+    return done;
+}
+
+// --- LOGIC: FIXED-TIMESTEP SCHEDULER ---
+// Converts elapsed time into a whole number of steps to run now. The fractional
+// remainder carries over, so rates below one step per slice work too.
+struct StepScheduler {
+    double budget = 0.0;
+
+    int consume(double seconds, double rate) {
+        budget += std::min(seconds, MAX_FRAME_TIME) * rate;
+        if (budget > MAX_STEPS_PER_SLICE) budget = MAX_STEPS_PER_SLICE;
+        int steps = (int)budget;
+        budget -= steps;
+        return steps;
+    }
+};
+
+// --- WORKER THREAD ---
+// Shuffling, trace recording and stepping all run here, in fixed-timestep slices of
+// WORKER_SLICE_SECONDS, so neither vsync nor event handling limits the sort rate and
+// the measured CPU time covers only the algorithm. The render thread submits commands
+// and adjusts the controls; the worker publishes SortSnapshots and atomic stats.
+struct WorkerCommand {
+    WorkerTask task = TASK_IDLE;
+    SortMode mode = BUBBLE_SORT;
+    bool replay = true;          // Record a trace and replay it instead of stepping live
+    bool networkLeaves = false;  // Finish small ranges with sorting networks
+    bool hardwareCounters = false; // Read the CPU counters around the sort
+    bool restoreInput = false;   // Sort the previous sort's input again, ignoring `values`
+    std::vector<int> values;     // Shuffled first when task is TASK_SHUFFLE
+    int maxValue = 1;            // Scales tone pitches
+    bool tones = true;           // Only one worker at a time may feed the tone ring
+    uint64_t seed = 0;           // Shuffle randomness
+    std::vector<TraceOp> recorded; // A loaded trace of sorting `values`, replayed instead of recording one
+};
+
+class SortWorker {
+public:
+
+    SortWorker() { observers.add(&blocks); observers.add(&heat); }
+    ~SortWorker() { stop(); }
+
+    void start() { quit = false; thread = std::thread([this] { run(); }); }
+    void stop() {
+        if (!thread.joinable()) return;
+        { std::lock_guard<std::mutex> lock(mutex); quit = true; }
+        wake.notify_one();
+        thread.join();
+    }
+
+    // Replaces whatever the worker is currently doing, at the start of its next slice.
+    void submit(WorkerCommand command) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending = std::move(command);
+            hasPending = true;
+            requested.fetch_add(1, std::memory_order_relaxed);
+        }
+        wake.notify_one();
+    }
+
+    // Saves the trace being replayed and its input. The worker owns both, so it writes
+    // the file itself before its next slice and reports the outcome on stdout/stderr.
+    void saveTrace(std::string path, bool compress) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            savePath = std::move(path);
+            saveCompressed = compress;
+        }
+        wake.notify_one();
+    }
+
+    TripleBuffer<SortSnapshot> snapshots;
+
+    // Controls, read at the start of every slice
+    std::atomic<double> rate{DEFAULT_STEPS_PER_SECOND};
+    std::atomic<double> targetSeconds{0.0};  // Paces the sort to take this long; 0 runs at `rate`
+    std::atomic<bool> paused{false};
+    std::atomic<int> direction{1};
+    std::atomic<bool> rewindRequested{false};
+
+    // Stats of the current task
+    std::atomic<unsigned long long> comparisons{0}, swaps{0};
+    std::atomic<double> cpuTimeMs{0.0};     // Live stepping time, or the recorded run's
+    std::atomic<double> measuredRate{0.0};  // Steps actually run per second
+    std::atomic<double> pacedRate{0.0}, estimatedSteps{0.0}; // The pacing's current rate and total
+    std::atomic<unsigned long long> bytesRead{0}, bytesWritten{0}; // Traffic model, live or of the recorded run
+    std::atomic<size_t> peakAuxBytes{0};                            // Peak aux memory of the same run
+    std::atomic<uint64_t> hardware[NUM_HW_COUNTERS] = {};          // Counters of the same run
+    std::atomic<unsigned> hardwareValid{0};                         // HardwareCounts::valid of the above
+    std::atomic<bool> countersUnavailable{false};                   // perf_event_open failed on this thread
+
+private:
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    WorkerCommand pending;
+    bool hasPending = false;
+    bool quit = false;
+    std::string savePath, saving; // Requested trace save, and the one being written
+    bool saveCompressed = false, savingCompressed = false;
+    std::atomic<unsigned> requested{0};  // Bumped by every submit(), so long recordings can bail out
+
+    std::vector<int> values;   // The array being worked on
+    std::vector<int> input;    // What the current sort started from
+    std::vector<int> scratch;  // Working copy the algorithm runs on while recording
+    ScratchArena arena;        // The stepper's own scratch space
+    OperationTrace trace;
+    std::vector<TraceOp> loaded; // A command's loaded trace, until its sort starts
+    BlockVersions blocks;
+    AccessHeat heat;
+    ArrayObserverList observers; // blocks and heat
+    StepScheduler scheduler;
+    double sortSeconds = 0.0;           // Wall time the live sort has been stepping
+    unsigned long long stepsRun = 0;    // Steps the live sort has taken
+    double paceSlope = 0.0;             // Recent steps per unit of progress()
+    double paceProgress = 0.0;          // progress() and stepsRun when paceSlope was updated
+    unsigned long long paceSteps = 0;
+    PerfCounters perf;
+    bool perfOpened = false;         // Opened on first use, so race panes never open any
+    HardwareCounts counts;           // Of the recorded run, or summed over the live slices
+    unsigned long long recordedRead = 0, recordedWritten = 0;
+    size_t recordedAux = 0;
+    std::unique_ptr<SortStepper> active;
+    TraceReplayStepper* replay = nullptr; // Non-null while `active` is replaying the trace
+    WorkerTask task = TASK_IDLE;
+    SortMode mode = BUBBLE_SORT;
+    bool replayWanted = true, networkLeaves = false, countersWanted = false;
+    float pitchScale = 0.0f;
+    unsigned generation = 0;   // `requested` when the current command was taken
+
+    void run() {
+        auto nextSlice = std::chrono::steady_clock::now();
+        Uint64 lastTick = SDL_GetPerformanceCounter();
+        Uint64 rateTick = lastTick;
+        long long rateSteps = 0;
+        while (true) {
+            bool changed = false;
+            WorkerCommand command;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (quit) return;
+                if (!savePath.empty()) { saving.swap(savePath); savingCompressed = saveCompressed; }
+                if (hasPending) {
+                    command = std::move(pending);
+                    hasPending = false;
+                    generation = requested.load(std::memory_order_relaxed);
+                    changed = true;
+                }
+            }
+            if (changed) begin(command);
+            if (!saving.empty()) { writeTrace(saving, savingCompressed); saving.clear(); }
+            if (rewindRequested.exchange(false) && replay) { replay->rewind(); changed = true; }
+
+            Uint64 now = SDL_GetPerformanceCounter();
+            int steps = runnable() ? runSlice(lastTick, now) : 0;
+            lastTick = now;
+            if (task == TASK_SHUFFLE && active->isDone()) { startSort(); changed = true; }
+
+            if (changed || steps > 0) { publishStats(); publish(); }
+            rateSteps += steps;
+            if (now - rateTick >= perfFreq / 4) {
+                measuredRate.store((double)rateSteps * perfFreq / (now - rateTick), std::memory_order_relaxed);
+                rateTick = now; rateSteps = 0;
+            }
+
+            nextSlice += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(WORKER_SLICE_SECONDS));
+            auto wallNow = std::chrono::steady_clock::now();
+            if (nextSlice < wallNow) nextSlice = wallNow; // Running flat out; don't try to catch up
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait_until(lock, nextSlice, [this] { return hasPending || quit || !savePath.empty(); });
+        }
+    }
+
+    void begin(WorkerCommand& command) {
+        if (command.restoreInput) values.assign(input.begin(), input.end());
+        else values.swap(command.values);
+        loaded.swap(command.recorded);
+        blocks.resize(values.size());
+        heat.resize(values.size());
+        mode = command.mode; replayWanted = command.replay; networkLeaves = command.networkLeaves;
+        countersWanted = command.hardwareCounters;
+        pitchScale = command.tones ? 1.0f / command.maxValue : 0.0f;
+        scheduler = StepScheduler();
+        replay = nullptr;
+        cpuTimeMs.store(0.0);
+        task = command.task;
+        if (task == TASK_SHUFFLE) {
+            active = std::make_unique<ShuffleStepper>(values, command.seed);
+            active->observer = &observers;
+        } else if (task == TASK_SORT) {
+            startSort();
+        } else {
+            active.reset();
+        }
+    }
+
+    void startSort() {
+        task = TASK_SORT;
+        replay = nullptr;
+        active.reset();
+        scheduler = StepScheduler();
+        sortSeconds = 0.0; stepsRun = 0;
+        paceSlope = EstimatedSortSteps(mode, (int)values.size()); paceProgress = 0.0; paceSteps = 0;
+        counts = HardwareCounts();
+        recordedRead = recordedWritten = 0; recordedAux = 0;
+        input.assign(values.begin(), values.end());
+        publishStats(); publish(); // Show the input while the trace records
+
+        if (loaded.empty() ? replayWanted && record() : adoptLoaded()) {
+            auto player = std::make_unique<TraceReplayStepper>(values, trace, input);
+            replay = player.get();
+            active = std::move(player);
+        } else {
+            cpuTimeMs.store(0.0);
+            counts = HardwareCounts(); // Drop a recording that didn't fit
+            active = CreateStepper(mode, values, arena, networkLeaves);
+        }
+        active->observer = &observers;
+    }
+
+    // Runs the whole algorithm at native speed on a copy of the input, recording every
+    // operation. The time spent is the run's real CPU time. Returns false if the trace
+    // did not fit in the buffer (or a newer command arrived), in which case the sort
+    // falls back to live stepping.
+    bool record() {
+        scratch.assign(input.begin(), input.end());
+        trace.clear();
+
+        std::unique_ptr<SortStepper> recorder = CreateStepper(mode, scratch, arena, networkLeaves);
+        if (!recorder->recordable()) return false;
+        recorder->trace = &trace;
+
+        bool measure = countersReady();
+        if (measure) perf.start();
+        Uint64 startTick = SDL_GetPerformanceCounter();
+        while (!recorder->isDone() && !trace.isFull() && !superseded()) recorder->step();
+        Uint64 endTick = SDL_GetPerformanceCounter();
+        if (measure) counts = perf.stop();
+
+        cpuTimeMs.store((double)((endTick - startTick) * 1000) / perfFreq);
+        recordedRead = recorder->bytesRead; recordedWritten = recorder->bytesWritten; recordedAux = recorder->peakAuxBytes;
+        return recorder->isDone() && trace.isComplete();
+    }
+
+    // Replays the command's loaded trace instead of recording one.
+    bool adoptLoaded() {
+        trace.clear();
+        for (const TraceOp& op : loaded) trace.append(op);
+        std::vector<TraceOp>().swap(loaded);
+        cpuTimeMs.store(0.0); // Nothing was timed in this session
+        return trace.isComplete();
+    }
+
+    void writeTrace(const std::string& path, bool compress) {
+        std::string error;
+        if (!replay) std::cerr << "No recorded trace to save (stepping live)\n";
+        else if (SaveTrace(path, mode, input, trace, compress, error)) std::cout << "Saved " << trace.size() << " operations to " << path << "\n";
+        else std::cerr << error << "\n";
+    }
+
+    bool superseded() const { return requested.load(std::memory_order_relaxed) != generation; }
+
+    // Whether this sort is measured, opening the counters the first time one is.
+    bool countersReady() {
+        if (!countersWanted) return false;
+        if (!perfOpened) { perfOpened = true; countersUnavailable.store(!perf.open()); }
+        return perf.available();
+    }
+
+    bool runnable() const {
+        if (!active) return false;
+        if (!replay) return !active->isDone();
+        if (paused.load(std::memory_order_relaxed)) return false;
+        return direction.load(std::memory_order_relaxed) > 0 ? !replay->isDone() : replay->position > 0;
+    }
+
+    // Runs the steps that [fromTick, toTick] is worth at the current rate.
+    int runSlice(Uint64 fromTick, Uint64 toTick) {
+        double seconds = (double)(toTick - fromTick) / perfFreq;
+        if (task == TASK_SHUFFLE) {
+            double shuffleRate = std::max(SHUFFLE_STEPS_PER_SECOND, values.size() / MAX_SHUFFLE_SECONDS);
+            return RunScheduledSteps(scheduler.consume(seconds, shuffleRate), fromTick, toTick, pitchScale, [&](int& sound) {
+                if (active->isDone()) return false;
+                active->step(); sound = active->soundValue;
+                return true;
+            });
+        }
+        int steps = scheduler.consume(seconds, sortRate(seconds));
+        if (replay) { // The real work was already done and timed by record()
+            if (direction.load(std::memory_order_relaxed) > 0) {
+                return RunScheduledSteps(steps, fromTick, toTick, pitchScale, [&](int& sound) {
+                    if (replay->isDone()) return false;
+                    replay->step(); sound = replay->soundValue;
+                    return true;
+                });
+            }
+            return RunScheduledSteps(steps, fromTick, toTick, pitchScale, [&](int& sound) {
+                if (replay->position == 0) return false;
+                replay->stepBack(); sound = replay->soundValue;
+                return true;
+            });
+        }
+
+        // --- START STOPWATCH ---
+        bool measure = countersReady();
+        if (measure) perf.start();
+        Uint64 startTick = SDL_GetPerformanceCounter();
+        SortStepper& stepper = *active;
+        int done = RunScheduledSteps(steps, fromTick, toTick, pitchScale, [&](int& sound) {
+            if (stepper.isDone()) return false;
+            stepper.step(); sound = stepper.soundValue;
+            return true;
+        });
+        // --- STOP STOPWATCH ---
+        Uint64 endTick = SDL_GetPerformanceCounter();
+        if (measure) counts += perf.stop();
+        cpuTimeMs.store(cpuTimeMs.load(std::memory_order_relaxed) + (double)((endTick - startTick) * 1000) / perfFreq, std::memory_order_relaxed);
+        stepsRun += done;
+        return done;
+    }
+
+    // The rate this slice runs at: the fixed one, or the pace that ends the sort at its
+    // target. A replay knows its exact length, so the trace takes the target either way.
+    // A live sort has only estimates, so it is paced to make progress() advance evenly
+    // over the remaining time, at the steps per progress it has recently needed (the
+    // complexity model until progress first moves). Aiming the remaining progress at the
+    // remaining time every slice keeps the finish on target even when progress is far
+    // from linear in steps, as in bubble sort's shrinking passes.
+    double sortRate(double seconds) {
+        double target = targetSeconds.load(std::memory_order_relaxed);
+        if (target <= 0.0) return rate.load(std::memory_order_relaxed);
+        double total, paced;
+        if (replay) {
+            total = (double)trace.size();
+            paced = total / target;
+        } else {
+            sortSeconds += std::min(seconds, MAX_FRAME_TIME);
+            double progress = std::clamp((double)active->progress(), 0.0, 1.0);
+            if (progress > paceProgress) {
+                double observed = (stepsRun - paceSteps) / (progress - paceProgress);
+                paceSlope += PACE_SMOOTHING * (observed - paceSlope);
+            }
+            if (progress != paceProgress) { paceProgress = progress; paceSteps = stepsRun; }
+            double remaining = paceSlope * std::max(1.0 - progress, 1.0 / std::max<size_t>(values.size(), 1));
+            total = stepsRun + remaining;
+            paced = remaining / std::max(target - sortSeconds, PACE_OVERRUN_SECONDS);
+        }
+        paced = std::clamp(paced, MIN_PACED_STEPS_PER_SECOND, MAX_STEPS_PER_SECOND);
+        pacedRate.store(paced, std::memory_order_relaxed);
+        estimatedSteps.store(total, std::memory_order_relaxed);
+        return paced;
+    }
+
+    void publishStats() {
+        comparisons.store(active ? active->comparisons : 0, std::memory_order_relaxed);
+        swaps.store(active ? active->swaps : 0, std::memory_order_relaxed);
+        bool live = active && !replay && task == TASK_SORT;
+        bytesRead.store(live ? active->bytesRead : recordedRead, std::memory_order_relaxed);
+        bytesWritten.store(live ? active->bytesWritten : recordedWritten, std::memory_order_relaxed);
+        peakAuxBytes.store(live ? active->peakAuxBytes : recordedAux, std::memory_order_relaxed);
+        for (int c = 0; c < NUM_HW_COUNTERS; c++) hardware[c].store(counts.value[c], std::memory_order_relaxed);
+        hardwareValid.store(counts.valid, std::memory_order_relaxed);
+    }
+
+    void publish() {
+        SortSnapshot& s = snapshots.back();
+        size_t blockCount = blocks.versions.size();
+        if (s.values.size() != values.size()) { s.values.resize(values.size()); s.versions.assign(blockCount, 0); }
+        const int* front = values.data();
+        const int* back = values.data();
+        int split = 0;
+        if (active) active->view(front, back, split);
+        for (size_t b = 0; b < blockCount; b++) {
+            if (s.versions[b] == blocks.versions[b]) continue;
+            size_t first = b * SNAPSHOT_BLOCK, last = std::min(values.size(), first + SNAPSHOT_BLOCK);
+            size_t middle = std::clamp((size_t)split, first, last);
+            std::copy(front + first, front + middle, s.values.begin() + first);
+            std::copy(back + middle, back + last, s.values.begin() + middle);
+            s.versions[b] = blocks.versions[b];
+        }
+        s.heatReads = heat.reads; s.heatWrites = heat.writes;
+        s.task = task;
+        s.done = active && active->isDone();
+        s.markCount = active && !s.done ? active->highlights(s.marks) : 0;
+        s.sortedBegin = s.sortedEnd = 0;
+        if (active && task == TASK_SORT) active->sortedRange(s.sortedBegin, s.sortedEnd);
+        s.progress = active ? active->progress() : 0.0f;
+        s.replaying = replay != nullptr;
+        s.replayPosition = replay ? replay->position : 0;
+        s.traceSize = replay ? trace.size() : 0;
+        snapshots.publish();
+    }
+};
+
+SortWorker worker;
+std::vector<uint64_t> appliedVersions; // Block versions of the snapshot `data` last caught up with
+
+// Brings `values` up to a snapshot, reporting every changed element to `observer`.
+// Only blocks whose version moved since `applied` are compared.
+void ApplySnapshot(const SortSnapshot& s, std::vector<int>& values, std::vector<uint64_t>& applied, ArrayObserver& observer) {
+    if (s.values.size() != values.size()) {
+        values.assign(s.values.begin(), s.values.end());
+        applied = s.versions;
+        observer.onReset();
+        return;
+    }
+    for (size_t b = 0; b < s.versions.size(); b++) {
+        if (applied[b] == s.versions[b]) continue;
+        size_t first = b * SNAPSHOT_BLOCK, last = std::min(values.size(), first + SNAPSHOT_BLOCK);
+        for (size_t k = first; k < last; k++) {
+            int old = values[k];
+            if (old == s.values[k]) continue;
+            values[k] = s.values[k];
+            observer.onWrite(k, old, values[k]);
+        }
+        applied[b] = s.versions[b];
+    }
+}
+
+// --- RACE MODE ---
+// A toggles a split-screen race: every algorithm sorts an identical copy of the array
+// at the same moment, each on its own worker thread. Every worker gets the same step
+// rate from its own fixed-timestep scheduler, so a slow O(N^2) sort can never starve a
+// fast one of steps; at full speed each simply runs as fast as its core allows. Panes
+// reuse the column bins and the batched bar geometry, so each costs one geometry call.
+const float RACE_TOP = 60.0f;            // Room for the race header
+const float RACE_LABEL_HEIGHT = 120.0f;  // Pane text above the bars
+const float RACE_PADDING = 6.0f;
+
+struct RacePane {
+    RacePane(SortMode mode, SDL_FRect area)
+        : mode(mode), area(area), bins(values, (int)(area.w - 2 * RACE_PADDING)) {
+        geometry.setArea(area.x + RACE_PADDING, area.w - 2 * RACE_PADDING, area.y + area.h - RACE_PADDING, area.h - RACE_LABEL_HEIGHT - RACE_PADDING);
+    }
+
+    SortMode mode;
+    SDL_FRect area;
+    std::vector<int> values;              // Display copy of the worker's array
+    std::vector<uint64_t> appliedVersions;
+    ColumnBins bins;
+    BarGeometry geometry;
+    SortWorker worker;
+    int place = 0;                        // Finishing position, 0 while still running
+};
+
+bool raceMode = false;
+std::vector<std::unique_ptr<RacePane>> racePanes;
+int raceFinishers = 0;
+SortMode raceToneMode = BUBBLE_SORT;  // Fixed per race session: the tone ring has one producer
+
+// Lays the panes out in a near-square grid below the header.
+SDL_FRect RacePaneArea(int index, int count) {
+    int cols = (int)std::ceil(std::sqrt((double)count));
+    int rows = (count + cols - 1) / cols;
+    float w = (float)WINDOW_WIDTH / cols, h = (WINDOW_HEIGHT - RACE_TOP) / rows;
+    return {(index % cols) * w, RACE_TOP + (index / cols) * h, w, h};
+}
+
+// Pushes the speed and replay controls to every running worker.
+void ApplyControls() {
+    auto apply = [](SortWorker& w) {
+        w.rate.store(stepsPerSecond); w.paused.store(replayPaused); w.direction.store(replayDirection);
+        w.targetSeconds.store(paceToTarget ? targetSeconds : 0.0);
+    };
+    apply(worker);
+    for (auto& pane : racePanes) apply(pane->worker);
+}
+
+void RequestRewind() {
+    worker.rewindRequested.store(true);
+    for (auto& pane : racePanes) pane->worker.rewindRequested.store(true);
+}
+
+void ResetReplayControls() {
+    replayPaused = false; replayDirection = 1;
+    ApplyControls();
+    worker.rewindRequested.store(false);
+    for (auto& pane : racePanes) pane->worker.rewindRequested.store(false);
     currentMaxProgress = 0.0f;
+}
 
-    preciseTimeMs = 0.0; // Reset accurate timer
+// Hands every pane the same command. Only raceToneMode's pane plays tones.
+void SubmitRace(const WorkerCommand& base) {
+    ResetReplayControls();
+    raceFinishers = 0;
+    for (auto& pane : racePanes) {
+        WorkerCommand command = base;
+        command.mode = pane->mode;
+        command.tones = pane->mode == raceToneMode;
+        command.hardwareCounters = false; // Panes have no room to show them
+        pane->place = 0;
+        pane->worker.submit(std::move(command));
+    }
+}
 
-    i = 0; j = 0;
-    if (currentMode == SELECTION_SORT) { minIdx = 0; j = 1; }
-    else if (currentMode == INSERTION_SORT) { i = 1; j = 1; }
-    else if (currentMode == QUICK_SORT) {
-        qsStack.clear(); qsStack.push_back({0, (int)data.size() - 1}); qs_partitionMode = false;
+void EnterRaceMode() {
+    worker.stop(); // The main worker must stop feeding tones before a pane starts
+    raceMode = true;
+    raceToneMode = currentMode;
+    for (int m = 0; m < NUM_SORT_MODES; m++) {
+        racePanes.push_back(std::make_unique<RacePane>((SortMode)m, RacePaneArea(m, NUM_SORT_MODES)));
+        racePanes.back()->worker.start();
     }
-    else if (currentMode == MERGE_SORT) {
-        ms_curr_size = 1; ms_left_start = 0; ms_copying = false; ms_temp = data;
+    // Everyone shuffles the current array with the same seed, so all inputs match
+    WorkerCommand command;
+    command.task = TASK_SHUFFLE; command.replay = replayEnabled; command.networkLeaves = networkLeaves; command.maxValue = MaxValue();
+    command.values = data;
+    command.seed = shuffleRng.next();
+    SubmitRace(command);
+}
+
+void LeaveRaceMode() {
+    racePanes.clear(); // Joins the pane workers
+    raceMode = false;
+    worker.start();
+}
+
+// Catches every pane up with its worker and records the finishing order.
+void UpdateRacePanes() {
+    for (auto& pane : racePanes) {
+        pane->worker.snapshots.acquire();
+        const SortSnapshot& view = pane->worker.snapshots.front();
+        ApplySnapshot(view, pane->values, pane->appliedVersions, pane->bins);
+        if (view.task == TASK_SORT && view.done && pane->place == 0) pane->place = ++raceFinishers;
+    }
+}
+
+void RenderRacePanes(SDL_Renderer* renderer) {
+    for (auto& pane : racePanes) {
+        const SortSnapshot& view = pane->worker.snapshots.front();
+        bool finished = pane->place > 0 && view.task == TASK_SORT;
+        int sortedBegin = finished ? 0 : view.sortedBegin, sortedEnd = finished ? (int)pane->values.size() : view.sortedEnd;
+        pane->bins.refresh();
+        pane->geometry.update(pane->bins, MaxValue(), columnAggregate, sortedBegin, sortedEnd, view.marks, finished ? 0 : view.markCount);
+        pane->geometry.draw(renderer);
+
+        SDL_SetRenderDrawColor(renderer, 40, 40, 50, 255);
+        SDL_FRect border = pane->area;
+        SDL_RenderRect(renderer, &border);
+
+        TextBuffer ss;
+        ss.precision(2);
+        ss << SORT_MODE_NAMES[pane->mode];
+        if (view.task == TASK_SHUFFLE) ss << "  shuffling";
+        else if (finished) ss << "  #" << pane->place;
+        ss << "\nCmp:  " << pane->worker.comparisons.load(std::memory_order_relaxed)
+           << "\nSwap: " << pane->worker.swaps.load(std::memory_order_relaxed)
+           << "\nCPU:  " << pane->worker.cpuTimeMs.load(std::memory_order_relaxed) << "ms"
+           << "\nAux:  " << HumanBytes{(double)pane->worker.peakAuxBytes.load(std::memory_order_relaxed)};
+        RenderUI(renderer, ss.view(), pane->area.x + 10.0f, pane->area.y + 8.0f);
     }
 }
 
+// --- LOGIC: RESET / PREPARE ---
+std::string savePrefix = "capture"; // S and Shift+S write <prefix>.array.svz and <prefix>.trace.svz
+bool compressSaves = false;    // --compress
+
+// Checks that a loaded file fits the visualizer and sizes the array and value range to
+// it. Arrays are shifted onto MIN_VALUE; traces can't be (their writes are XORs of the
+// recorded values), so their keys must already fit.
+bool FitLoadedFile(DataFile& file, std::string& error) {
+    if (file.values.size() < 2 || file.values.size() > (size_t)MAX_NUM_ELEMENTS) {
+        error = "the visualizer shows 2 to 16M elements; sort larger files with --external"; return false;
+    }
+    if (file.header.kind == DATA_ARRAY && !ShiftKeys(file.values, error)) return false;
+    auto [low, high] = std::minmax_element(file.values.begin(), file.values.end());
+    if (*low < MIN_VALUE || (long long)*high - MIN_VALUE >= MAX_VALUE_RANGE) { error = "the trace's keys are outside the value range"; return false; }
+    numElements = (int)file.values.size();
+    valueRange = *high - MIN_VALUE + 1;
+    return true;
+}
+
+// Replays a loaded trace from its recorded input, as if this session had recorded it.
+void ReplayLoadedTrace(DataFile& file) {
+    currentMode = (SortMode)file.header.mode;
+    WorkerCommand command;
+    command.task = TASK_SORT; command.mode = currentMode; command.replay = true; command.maxValue = MaxValue();
+    loadedInput = file.values; // Other algorithms sort the same input
+    command.values = std::move(file.values);
+    command.recorded = std::move(file.ops);
+    ResetReplayControls();
+    worker.submit(std::move(command));
+}
+
+// Sorts again from the same input, e.g. after toggling replay.
+void PrepareForSort() {
+    WorkerCommand command;
+    command.task = TASK_SORT; command.mode = currentMode; command.replay = replayEnabled; command.networkLeaves = networkLeaves;
+    command.hardwareCounters = hardwareCounters; command.restoreInput = true; command.maxValue = MaxValue();
+    if (raceMode) { SubmitRace(command); return; }
+    ResetReplayControls();
+    worker.submit(std::move(command));
+}
+
 void ResetSort(SortMode newMode, bool generateNewData) {
     currentMode = newMode;
-    targetHeight.store(0);
+    WorkerCommand command;
+    command.mode = newMode; command.replay = replayEnabled; command.networkLeaves = networkLeaves; command.maxValue = MaxValue();
+    command.hardwareCounters = hardwareCounters;
     if (generateNewData) {
-        data.clear();
-        for (int k = 0; k < NUM_RECTANGLES; k++) data.push_back(rand() % 100 + 5);
-        PrepareForSort();
+        command.task = TASK_SORT;
+        if (!loadedInput.empty()) command.values = loadedInput;
+        else GenerateInput(inputDistribution, command.values, numElements, valueRange, inputRng);
     } else {
-        isShuffling = true; shuffle_i = 0; isSorted = false;
-        currentMaxProgress = 0.0f;
+        command.task = TASK_SHUFFLE;
+        command.values = raceMode ? racePanes[0]->values : data;
+        command.seed = shuffleRng.next();
     }
+    if (raceMode) { SubmitRace(command); return; }
+    ResetReplayControls();
+    worker.submit(std::move(command));
+}
+
+// --- HEADLESS BENCHMARK ---
+// `--bench` runs every stepper, plus the plain loop version of the same algorithm from
+// sortcore.h, at full native speed without opening a window or audio device.
+const char* BENCH_TYPES[] = {"int32", "uint64", "float", "record16"};
+
+struct BenchOptions {
+    std::vector<int> sizes = {1000, 10000};
+    std::vector<std::string> algorithms;     // Empty means all
+    std::vector<std::string> distributions;  // Empty means all
+    std::vector<std::string> types = {"int32"};
+    std::vector<std::string> files;          // --load: data files benched as they are, at their own N
+    int repetitions = 5;
+    int quadraticLimit = 20000;              // O(N^2) sorts are skipped above this N
+    bool counters = false;                   // Add the hardware counter columns
+    bool json = false;
+};
+
+PerfCounters benchCounters; // Opened on the main thread, which runs every case
+
+struct BenchResult {
+    const char* algorithm;
+    const char* impl;
+    const char* type;
+    std::string distribution;
+    int n;
+    double medianNsPerElement;
+    double p99NsPerElement;
+    OpCounts counts;
+    double speedup = 0.0;  // Baseline median / this median: serial vs parallel, library vs hybrid
+    bool hasTraffic = false; // Only the steppers model their memory traffic and aux memory
+    unsigned long long bytesRead = 0, bytesWritten = 0;
+    size_t peakAuxBytes = 0;
+    HardwareCounts hardware; // Median of each counter over the repetitions
+};
+
+// Nearest-rank percentile of an already sorted sample.
+double Percentile(const std::vector<double>& sorted, double pct) {
+    int rank = (int)std::ceil(pct / 100.0 * sorted.size());
+    return sorted[std::clamp(rank - 1, 0, (int)sorted.size() - 1)];
+}
+
+std::vector<std::string> SplitList(std::string_view list) {
+    std::vector<std::string> out;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string_view::npos) end = list.size();
+        if (end > start) out.emplace_back(list.substr(start, end - start));
+        start = end + 1;
+    }
+    return out;
+}
+
+bool Selected(const std::vector<std::string>& filter, std::string_view name) {
+    return filter.empty() || std::find(filter.begin(), filter.end(), name) != filter.end();
+}
+
+// Times `run` over every repetition on a fresh copy of the same input.
+template <typename T, typename Less, typename Run>
+BenchResult MeasureRuns(const BenchOptions& opt, const std::vector<T>& input, Run run) {
+    std::vector<double> nsPerElement;
+    std::vector<HardwareCounts> hardware;
+    OpCounts counts;
+    bool measure = opt.counters && benchCounters.available();
+    for (int rep = 0; rep < opt.repetitions; rep++) {
+        std::vector<T> work = input;
+        OpCounts repCounts;
+        if (measure) benchCounters.start();
+        auto start = std::chrono::steady_clock::now();
+        run(work, repCounts);
+        auto end = std::chrono::steady_clock::now();
+        if (measure) hardware.push_back(benchCounters.stop());
+        double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        nsPerElement.push_back(ns / std::max<size_t>(input.size(), 1));
+        if (!std::is_sorted(work.begin(), work.end(), Less())) std::cerr << "warning: output not sorted\n";
+        counts = repCounts;
+    }
+    std::sort(nsPerElement.begin(), nsPerElement.end());
+    BenchResult result{};
+    result.n = input.size();
+    result.medianNsPerElement = Percentile(nsPerElement, 50.0);
+    result.p99NsPerElement = Percentile(nsPerElement, 99.0);
+    result.counts = counts;
+    for (int c = 0; measure && c < NUM_HW_COUNTERS; c++) {
+        std::vector<double> sample;
+        for (const HardwareCounts& h : hardware) if (h.has(c)) sample.push_back((double)h.value[c]);
+        if (sample.empty()) continue;
+        std::sort(sample.begin(), sample.end());
+        result.hardware.value[c] = (uint64_t)Percentile(sample, 50.0);
+        result.hardware.valid |= 1u << c;
+    }
+    return result;
+}
+
+void PrintBenchResults(const std::vector<BenchResult>& results, bool json, bool counters) {
+    std::cout << std::fixed << std::setprecision(3);
+    if (json) {
+        std::cout << "[\n";
+        for (size_t k = 0; k < results.size(); k++) {
+            const BenchResult& r = results[k];
+            std::cout << "  {\"algorithm\": \"" << r.algorithm << "\", \"impl\": \"" << r.impl
+                      << "\", \"type\": \"" << r.type << "\", \"distribution\": \"" << r.distribution << "\", \"n\": " << r.n
+                      << ", \"median_ns_per_element\": " << r.medianNsPerElement
+                      << ", \"p99_ns_per_element\": " << r.p99NsPerElement
+                      << ", \"comparisons\": " << r.counts.comparisons
+                      << ", \"swaps\": " << r.counts.swaps;
+            if (r.speedup > 0.0) std::cout << ", \"speedup\": " << r.speedup;
+            if (r.hasTraffic) std::cout << ", \"bytes_read\": " << r.bytesRead << ", \"bytes_written\": " << r.bytesWritten << ", \"peak_aux_bytes\": " << r.peakAuxBytes;
+            for (int c = 0; c < NUM_HW_COUNTERS; c++)
+                if (r.hardware.has(c)) std::cout << ", \"" << HW_COUNTER_NAMES[c] << "\": " << r.hardware.value[c];
+            std::cout << "}"
+                      << (k + 1 < results.size() ? ",\n" : "\n");
+        }
+        std::cout << "]\n";
+    } else {
+        std::cout << "algorithm,impl,type,distribution,n,median_ns_per_element,p99_ns_per_element,comparisons,swaps,speedup,bytes_read,bytes_written,peak_aux_bytes";
+        if (counters) for (const char* name : HW_COUNTER_NAMES) std::cout << ',' << name;
+        std::cout << '\n';
+        for (const BenchResult& r : results) {
+            std::cout << r.algorithm << ',' << r.impl << ',' << r.type << ',' << r.distribution << ',' << r.n << ','
+                      << r.medianNsPerElement << ',' << r.p99NsPerElement << ','
+                      << r.counts.comparisons << ',' << r.counts.swaps << ',';
+            if (r.speedup > 0.0) std::cout << r.speedup;
+            std::cout << ',';
+            if (r.hasTraffic) std::cout << r.bytesRead << ',' << r.bytesWritten << ',' << r.peakAuxBytes;
+            else std::cout << ",,";
+            for (int c = 0; counters && c < NUM_HW_COUNTERS; c++) {
+                std::cout << ',';
+                if (r.hardware.has(c)) std::cout << r.hardware.value[c];
+            }
+            std::cout << '\n';
+        }
+    }
+}
+
+// Whether `--network` changes how this algorithm sorts its small ranges.
+template <typename T, typename Less>
+bool NetworkImpl(const BenchAlgorithm<T, Less>& algo) { return networkLeaves && !algo.library && UsesNetworkLeaves(algo.mode); }
+
+// Benchmarks the selected algorithms on `keys` converted to T. Only int32 gets stepper
+// rows: the steppers are the visualizer's, and it animates int keys.
+template <typename T, typename Less>
+void BenchElementType(const BenchOptions& opt, const char* dist, const std::vector<int>& keys, ScratchArena& arena, std::vector<BenchResult>& results) {
+    const auto& algorithms = BENCH_ALGORITHMS<T, Less>;
+    constexpr bool hasSteppers = std::is_same_v<T, int>;
+    const char* type = ElementTraits<T>::NAME;
+    int n = keys.size();
+    std::vector<T> input(n);
+    for (int k = 0; k < n; k++) input[k] = ElementTraits<T>::FromKey(keys[k], k);
+
+    auto measureReference = [&](const BenchAlgorithm<T, Less>& algo) {
+        BenchResult reference = MeasureRuns<T, Less>(opt, input, algo.reference);
+        reference.algorithm = algo.id; reference.impl = algo.library ? "library" : NetworkImpl(algo) ? "reference-network" : "reference";
+        reference.type = type; reference.distribution = dist;
+        return reference;
+    };
+    // Both rows of each case, so baselines that were not selected are measured on
+    // demand, and only once. A library sort is its own stepper-row baseline.
+    BenchResult rows[std::size(BENCH_ALGORITHMS<T, Less>)][2] = {};
+    auto measure = [&](size_t a) {
+        const BenchAlgorithm<T, Less>& algo = algorithms[a];
+        if (rows[a][1].algorithm) return;
+        rows[a][1] = measureReference(algo);
+        if constexpr (hasSteppers) {
+            if (algo.library) { rows[a][0] = rows[a][1]; return; }
+            unsigned long long bytesRead = 0, bytesWritten = 0;
+            size_t peakAux = 0;
+            rows[a][0] = MeasureRuns<T, Less>(opt, input, [&](std::vector<int>& v, OpCounts& c) {
+                std::unique_ptr<SortStepper> s = CreateStepper(algo.mode, v, arena, networkLeaves);
+                while (!s->isDone()) s->step();
+                c.comparisons = s->comparisons; c.swaps = s->swaps;
+                bytesRead = s->bytesRead; bytesWritten = s->bytesWritten; peakAux = s->peakAuxBytes;
+            });
+            rows[a][0].hasTraffic = true; rows[a][0].bytesRead = bytesRead; rows[a][0].bytesWritten = bytesWritten;
+            rows[a][0].peakAuxBytes = peakAux;
+            rows[a][0].algorithm = algo.id; rows[a][0].impl = NetworkImpl(algo) ? "stepper-network" : "stepper";
+            rows[a][0].type = type; rows[a][0].distribution = dist;
+        }
+    };
+
+    for (size_t a = 0; a < std::size(algorithms); a++) {
+        const BenchAlgorithm<T, Less>& algo = algorithms[a];
+        if (!Selected(opt.algorithms, algo.id)) continue;
+        if (algo.quadratic && n > opt.quadraticLimit) continue;
+        if (algo.gpu && (!hasSteppers || !gpuCompute.ready())) continue;
+
+        measure(a);
+        BenchResult stepped = rows[a][0], reference = rows[a][1];
+        if (algo.baseline) {
+            int baseline = FindBenchAlgorithm<T, Less>(algo.baseline);
+            measure(baseline);
+            const BenchResult* base = rows[baseline];
+            if (hasSteppers) stepped.speedup = base[0].medianNsPerElement / std::max(stepped.medianNsPerElement, 1e-9);
+            reference.speedup = base[1].medianNsPerElement / std::max(reference.medianNsPerElement, 1e-9);
+        }
+        if (hasSteppers && !algo.library) results.push_back(stepped);
+        results.push_back(reference);
+    }
+}
+
+int RunBenchmarks(const BenchOptions& opt) {
+    std::vector<BenchResult> results;
+    ScratchArena arena; // Shared by every stepper run, like the visualizer's worker
+    if (opt.counters && !benchCounters.open()) std::cerr << "warning: hardware counters unavailable (perf_event_open failed)\n";
+    std::cerr << "seed " << randomSeed << " (--seed " << randomSeed << " generates the same inputs)\n";
+    // Every element type sorts the same keys
+    auto benchTypes = [&](const char* dist, const std::vector<int>& keys) {
+        for (const std::string& type : opt.types) {
+            if (type == "int32") BenchElementType<int, std::less<int>>(opt, dist, keys, arena, results);
+            else if (type == "uint64") BenchElementType<uint64_t, std::less<uint64_t>>(opt, dist, keys, arena, results);
+            else if (type == "float") BenchElementType<float, std::less<float>>(opt, dist, keys, arena, results);
+            else if (type == "record16") BenchElementType<Record16, RecordLess>(opt, dist, keys, arena, results);
+        }
+    };
+    // Loaded files replace the generated distributions unless --dist asks for some too
+    bool generated = opt.files.empty() || !opt.distributions.empty();
+    for (int d = 0; d < NUM_INPUT_DISTRIBUTIONS && generated; d++) {
+        const char* dist = INPUT_DISTRIBUTION_NAMES[d];
+        if (!Selected(opt.distributions, dist)) continue;
+        for (int n : opt.sizes) {
+            // Each case has its own stream, so a subset of the cases gets the same keys
+            Xoshiro256 rng(randomSeed ^ (uint64_t)d << 40 ^ (uint64_t)n);
+            std::vector<int> keys;
+            GenerateInput((InputDistribution)d, keys, n, valueRange, rng);
+            benchTypes(dist, keys);
+        }
+    }
+    for (const std::string& path : opt.files) {
+        DataFile file;
+        std::string error;
+        if (!LoadDataFile(path, file, error) || !ShiftKeys(file.values, error)) { std::cerr << error << "\n"; return 1; }
+        benchTypes(path.c_str(), file.values); // A trace's input is benched like an array
+    }
+    if (Selected(opt.algorithms, "gpu_bitonic") && !gpuCompute.ready()) std::cerr << "gpu_bitonic skipped: " << gpuCompute.status() << "\n";
+    gpuCompute.shutdown();
+    PrintBenchResults(results, opt.json, opt.counters);
+    return 0;
+}
+
+// Parses the `--bench` flags. Returns false on a malformed command line.
+bool ParseBenchOptions(int argc, char* argv[], BenchOptions& opt) {
+    for (int k = 1; k < argc; k++) {
+        std::string_view arg = argv[k];
+        bool hasValue = k + 1 < argc;
+        if (arg == "--bench") continue;
+        else if (arg == "--json") opt.json = true;
+        else if (arg == "--csv") opt.json = false;
+        else if (arg == "--n" && hasValue) {
+            opt.sizes.clear();
+            for (const std::string& size : SplitList(argv[++k])) opt.sizes.push_back(std::max(0, std::atoi(size.c_str())));
+        }
+        else if (arg == "--algo" && hasValue) opt.algorithms = SplitList(argv[++k]);
+        else if (arg == "--dist" && hasValue) {
+            opt.distributions = SplitList(argv[++k]);
+            for (const std::string& dist : opt.distributions)
+                if (FindInputDistribution(dist) < 0) { std::cerr << "Unknown distribution: " << dist << "\n"; return false; }
+        }
+        else if (arg == "--swaps" && hasValue) nearlySortedSwaps = std::max(0, std::atoi(argv[++k]));
+        else if (arg == "--type" && hasValue) {
+            opt.types = SplitList(argv[++k]);
+            for (const std::string& type : opt.types)
+                if (std::find(std::begin(BENCH_TYPES), std::end(BENCH_TYPES), type) == std::end(BENCH_TYPES)) {
+                    std::cerr << "Unknown element type: " << type << " (int32, uint64, float or record16)\n";
+                    return false;
+                }
+        }
+        else if (arg == "--reps" && hasValue) opt.repetitions = std::max(1, std::atoi(argv[++k]));
+        else if (arg == "--quadratic-limit" && hasValue) opt.quadraticLimit = std::atoi(argv[++k]);
+        else if (arg == "--range" && hasValue) valueRange = std::clamp(std::atoi(argv[++k]), 1, MAX_VALUE_RANGE);
+        else if (arg == "--threads" && hasValue) benchThreads = std::max(1, std::atoi(argv[++k]));
+        else if (arg == "--network") networkLeaves = true;
+        else if (arg == "--counters") opt.counters = true;
+        else if (arg == "--load" && hasValue) opt.files = SplitList(argv[++k]);
+        else if (arg == "--seed" && hasValue) SeedRandom(std::strtoull(argv[++k], nullptr, 0));
+        else {
+            std::cerr << "Unknown or incomplete option: " << arg << "\n"
+                      << "Usage: --bench [--n 1000,10000] [--algo bubble,quick,...] [--dist random,sorted,...] [--swaps K] [--seed S]\n"
+                      << "               [--type int32,uint64,float,record16] [--load keys.svz,...]\n"
+                      << "               [--reps 5] [--quadratic-limit 20000] [--range 100] [--threads N] [--network] [--counters] [--csv | --json]\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// --- EXTERNAL SORT ---
+// --external FILE sorts a binary file of native-endian int32 keys that need not fit in
+// memory. The input and output are memory-mapped. Run generation copies --run-length
+// keys at a time into a vector, sorts them with a visualizer stepper run to completion
+// and writes the run back out; merge passes then combine --fan-in runs at a time with a
+// loser tree, streaming every run through its own --io-kb buffer so both sides see
+// large sequential block copies. With read-ahead on, the mappings are advised
+// sequential and each source asks for its next block while it drains the current one;
+// --no-readahead advises random access instead, which turns the kernel's read-ahead
+// off. Passes ping-pong between the output and FILE.sorted.runs, starting on whichever
+// makes the last pass land in the output.
+const int EXTERNAL_PREVIEW = WINDOW_WIDTH;               // Keys shown, one per pixel column
+const size_t EXTERNAL_GENERATE_CHUNK = (size_t)1 << 24;  // --external-generate writes this many keys at a time
+
+struct ExternalOptions {
+    std::string input, output;  // The output defaults to input + ".sorted"
+    long long generate = 0;     // First write this many keys (--dist, --range) to the input
+    int runLength = 1 << 20;    // Keys sorted in memory at once
+    int fanIn = 16;             // Runs per merge
+    int ioKiB = 1024;           // Buffer per merge source, and for the output
+    bool readAhead = true;
+    SortMode runSort = PDQ_SORT;
+};
+
+ExternalOptions externalOptions;
+bool externalMode = false;  // --external replaces the interactive sorts with the file sort
+
+// Tournament over k sorted sources. tree[0] holds the source with the smallest head and
+// every other node the loser of the match played there, so replacing the winner's
+// head replays one leaf-to-root path: ceil(log2 k) comparisons per key. Exhausted
+// sources lose to everything, and ties go to the lower source, which keeps the merge
+// stable.
+class LoserTree {
+public:
+    // Sources start exhausted; give each a head with set() before build().
+    void reset(int k) { tree.assign(k, -1); heads.assign(k, 0); exhausted.assign(k, 1); }
+    void set(int source, int head) { heads[source] = head; exhausted[source] = 0; }
+    void build() {
+        int k = (int)tree.size();
+        std::fill(tree.begin(), tree.end(), -1);
+        // Each source climbs until it finds an empty node to wait at; the second arrival
+        // at a node plays the first, and only the winner climbs on
+        for (int s = 0; s < k; s++) {
+            int climber = s, t = (s + k) / 2;
+            for (; t > 0; t /= 2) {
+                if (tree[t] < 0) { tree[t] = climber; break; }
+                if (beats(tree[t], climber)) std::swap(climber, tree[t]);
+            }
+            if (t == 0) tree[0] = climber;
+        }
+    }
+    int winner() const { return tree[0]; }
+    bool empty() const { return exhausted[tree[0]]; }
+    int head() const { return heads[tree[0]]; }
+    // The winner moves on to `next`, or runs out.
+    void replace(int next) { heads[tree[0]] = next; replay(); }
+    void retire() { exhausted[tree[0]] = 1; replay(); }
+
+    unsigned long long comparisons = 0;
+
+private:
+    std::vector<int> tree, heads;
+    std::vector<char> exhausted;
+
+    bool beats(int a, int b) {
+        if (exhausted[a] || exhausted[b]) return !exhausted[a] || (exhausted[b] && a < b);
+        comparisons++;
+        return heads[a] < heads[b] || (heads[a] == heads[b] && a < b);
+    }
+    void replay() {
+        int k = (int)tree.size(), climber = tree[0];
+        for (int t = (climber + k) / 2; t > 0; t /= 2)
+            if (beats(tree[t], climber)) std::swap(climber, tree[t]);
+        tree[0] = climber;
+    }
+};
+
+enum ExternalPhase { EXTERNAL_IDLE, EXTERNAL_GENERATING, EXTERNAL_RUNS, EXTERNAL_MERGING, EXTERNAL_DONE, EXTERNAL_FAILED };
+
+// Runs the whole external sort on its own thread, publishing its progress through
+// atomics and a preview of EXTERNAL_PREVIEW evenly spaced keys of the file being
+// written, refreshed as each block lands there.
+class ExternalSorter {
+public:
+    ~ExternalSorter() { stop(); }
+
+    // Starts over with `options`, abandoning any sort still running.
+    void start(const ExternalOptions& options, Xoshiro256 rng) {
+        stop();
+        opt = options;
+        generatorRng = rng;
+        cancel = false;
+        error.clear();
+        phase = EXTERNAL_IDLE;
+        keys = written = groupBegin = groupEnd = 0;
+        runsDone = runs = pass = passes = 0;
+        bytesRead = bytesWritten = phaseBytesRead = phaseBytesWritten = comparisons = 0;
+        previewCount = 0;
+        totalSeconds = 0.0;
+        thread = std::thread([this] { run(); });
+    }
+    void stop() {
+        cancel = true;
+        if (thread.joinable()) thread.join();
+    }
+
+    std::atomic<int> phase{EXTERNAL_IDLE};
+    std::atomic<long long> keys{0};                    // Keys in the file
+    std::atomic<long long> written{0};                 // Keys of the current target written so far this phase
+    std::atomic<long long> groupBegin{0}, groupEnd{0}; // Run being sorted, or runs being merged
+    std::atomic<int> runsDone{0}, runs{0};             // Run generation
+    std::atomic<int> pass{0}, passes{0};               // Merge passes
+    std::atomic<unsigned long long> bytesRead{0}, bytesWritten{0};
+    std::atomic<unsigned long long> phaseBytesRead{0}, phaseBytesWritten{0};
+    std::atomic<unsigned long long> comparisons{0};
+    std::atomic<Uint64> phaseStart{0};                 // Performance-counter time the phase began
+    std::atomic<double> totalSeconds{0.0};             // Set once done
+    std::atomic<int> minKey{0}, maxKey{0};             // Of the keys seen so far
+    std::atomic<int> preview[EXTERNAL_PREVIEW];
+    std::atomic<int> previewCount{0};
+    std::string error;  // Why it failed; read once phase is EXTERNAL_FAILED
+
+private:
+    struct MergeSource {
+        std::vector<int> buffer;
+        int position = 0, length = 0;
+        long long next = 0, end = 0;  // Keys of the run not yet buffered
+    };
+    struct PhaseStats { std::string name; double seconds; unsigned long long read, written; };
+
+    ExternalOptions opt;
+    Xoshiro256 generatorRng;
+    std::thread thread;
+    std::atomic<bool> cancel{false};
+    long long n = 0;
+    int block = 0;          // Keys per I/O buffer
+    int previewSize = 0;
+    std::vector<PhaseStats> history;
+
+    bool fail(std::string why) {
+        std::cerr << "external sort: " << why << "\n";
+        error = std::move(why);
+        phase.store(EXTERNAL_FAILED, std::memory_order_release);
+        return false;
+    }
+
+    void beginPhase(ExternalPhase p) {
+        written = 0; phaseBytesRead = 0; phaseBytesWritten = 0;
+        phaseStart = SDL_GetPerformanceCounter();
+        phase = p;
+    }
+    void endPhase(std::string name) {
+        double seconds = (double)(SDL_GetPerformanceCounter() - phaseStart) / SDL_GetPerformanceFrequency();
+        history.push_back({std::move(name), seconds, phaseBytesRead, phaseBytesWritten});
+    }
+    void noteRead(long long count) { bytesRead += count * sizeof(int); phaseBytesRead += count * sizeof(int); }
+    void noteWritten(long long count) { bytesWritten += count * sizeof(int); phaseBytesWritten += count * sizeof(int); }
+
+    // Key position shown in preview column i, and the first column at or past a position
+    long long samplePosition(int i) const { return (long long)i * n / previewSize; }
+    int firstSample(long long position) const { return (int)((position * previewSize + n - 1) / n); }
+    void updatePreview(const int* block, long long begin, long long end) {
+        for (int i = firstSample(begin); i < previewSize && samplePosition(i) < end; i++)
+            preview[i].store(block[samplePosition(i) - begin], std::memory_order_relaxed);
+    }
+
+    void run() {
+        Uint64 started = SDL_GetPerformanceCounter();
+        history.clear();
+        if (opt.generate > 0 && !generate()) return;
+
+        MappedFile input, output, spare;
+        if (!input.openRead(opt.input)) { fail("cannot map " + opt.input); return; }
+        // A data file's header is copied to the output, so the sorted file loads the same way
+        size_t offset;
+        if (!MappableKeys(input, offset, error)) { fail(error); return; }
+        input.setOffset(offset);
+        n = (long long)input.count();
+        keys = n;
+        long long runLength = std::max(opt.runLength, 2);
+        int fanIn = std::max(opt.fanIn, 2);
+        long long runCount = (n + runLength - 1) / runLength;
+        int passCount = 0;
+        for (long long r = runCount; r > 1; r = (r + fanIn - 1) / fanIn) passCount++;
+        runs = (int)runCount; passes = passCount;
+        block = std::max(opt.ioKiB * 1024 / (int)sizeof(int), 1024);
+
+        std::string sparePath = opt.output + ".runs";
+        size_t bytes = (size_t)n * sizeof(int);
+        if (!output.create(opt.output, offset + bytes)) { fail("cannot create " + opt.output); return; }
+        if (passCount > 0 && !spare.create(sparePath, offset + bytes)) { fail("cannot create " + sparePath); return; }
+        if (offset) {
+            DataFileHeader header;
+            header.elements = n; header.payloadBytes = bytes;
+            std::memcpy(output.keys(), &header, sizeof(header)); // Before the offset moves keys() past it
+        }
+        output.setOffset(offset); spare.setOffset(offset);
+        for (MappedFile* f : {&input, &output, &spare}) f->advise(opt.readAhead);
+
+        // The preview starts as a sample of the input, a page touched per column
+        previewSize = (int)std::min<long long>(n, EXTERNAL_PREVIEW);
+        const int* in = input.keys();
+        int low = INT_MAX, high = INT_MIN;
+        for (int i = 0; i < previewSize; i++) {
+            int key = in[samplePosition(i)];
+            preview[i].store(key, std::memory_order_relaxed);
+            low = std::min(low, key); high = std::max(high, key);
+        }
+        minKey = low; maxKey = high;
+        previewCount = previewSize;
+
+        // An odd number of passes starts in the spare file, so the last one ends in the output
+        MappedFile* target = passCount % 2 == 0 ? &output : &spare;
+        MappedFile* other = passCount % 2 == 0 ? &spare : &output;
+        if (!generateRuns(input, target->keys(), runLength)) return;
+        input.close();
+        for (int p = 1; p <= passCount; p++, runLength *= fanIn) {
+            pass = p;
+            if (!mergePass(*target, other->keys(), runLength, fanIn)) return;
+            std::swap(target, other);
+        }
+        output.close(); spare.close();
+        if (passCount > 0) std::remove(sparePath.c_str());
+
+        totalSeconds = (double)(SDL_GetPerformanceCounter() - started) / SDL_GetPerformanceFrequency();
+        phase.store(EXTERNAL_DONE, std::memory_order_release);
+        printSummary();
+    }
+
+    // Writes opt.generate keys of the --dist distribution, EXTERNAL_GENERATE_CHUNK at a
+    // time, so the shapes repeat for every chunk of a larger file.
+    bool generate() {
+        beginPhase(EXTERNAL_GENERATING);
+        std::ofstream out(opt.input, std::ios::binary | std::ios::trunc);
+        if (!out) return fail("cannot write " + opt.input);
+        std::vector<int> chunk;
+        for (long long done = 0; done < opt.generate && !cancel; ) {
+            int count = (int)std::min<long long>(opt.generate - done, EXTERNAL_GENERATE_CHUNK);
+            GenerateInput(inputDistribution, chunk, count, valueRange, generatorRng);
+            out.write(reinterpret_cast<const char*>(chunk.data()), (std::streamsize)count * sizeof(int));
+            done += count;
+            written = done;
+            noteWritten(count);
+        }
+        if (!out) return fail("failed writing " + opt.input);
+        endPhase("generate");
+        return !cancel;
+    }
+
+    // Sorts each run in memory with the chosen stepper and writes it to `out`.
+    bool generateRuns(MappedFile& input, int* out, long long runLength) {
+        const int* in = input.keys();
+        beginPhase(EXTERNAL_RUNS);
+        std::vector<int> chunk;
+        ScratchArena arena;
+        for (long long begin = 0; begin < n; begin += runLength) {
+            long long end = std::min(n, begin + runLength);
+            groupBegin = begin; groupEnd = end;
+            chunk.assign(in + begin, in + end);
+            noteRead(end - begin);
+            if (opt.readAhead) input.willNeed(end, runLength); // Sorting overlaps the next read
+            std::unique_ptr<SortStepper> stepper = CreateStepper(opt.runSort, chunk, arena);
+            for (unsigned steps = 0; !stepper->isDone(); steps++) {
+                if ((steps & 4095) == 0 && cancel) return false;
+                stepper->step();
+            }
+            comparisons += stepper->comparisons;
+            minKey = std::min(minKey.load(), chunk.front());
+            maxKey = std::max(maxKey.load(), chunk.back());
+            std::memcpy(out + begin, chunk.data(), chunk.size() * sizeof(int));
+            noteWritten(end - begin);
+            updatePreview(chunk.data(), begin, end);
+            written = end;
+            runsDone++;
+        }
+        endPhase("run generation");
+        return true;
+    }
+
+    // Merges every fanIn consecutive runs of `from` into longer runs in `to`.
+    bool mergePass(MappedFile& from, int* to, long long runLength, int fanIn) {
+        beginPhase(EXTERNAL_MERGING);
+        sourceFile = &from;
+        std::vector<MergeSource> sources(fanIn);
+        for (MergeSource& s : sources) s.buffer.resize(block);
+        std::vector<int> out(block);
+        LoserTree tree;
+        for (long long begin = 0; begin < n; begin += runLength * fanIn) {
+            long long end = std::min(n, begin + runLength * fanIn);
+            int k = (int)((end - begin + runLength - 1) / runLength);
+            groupBegin = begin; groupEnd = end;
+            tree.reset(k);
+            for (int i = 0; i < k; i++) {
+                MergeSource& s = sources[i];
+                s.next = begin + i * runLength; s.end = std::min(end, s.next + runLength);
+                s.position = s.length = 0;
+                if (refill(s)) tree.set(i, s.buffer[0]);
+            }
+            tree.build();
+            long long outPosition = begin;
+            int outLength = 0;
+            while (!tree.empty()) {
+                MergeSource& s = sources[tree.winner()];
+                out[outLength++] = tree.head();
+                if (++s.position < s.length || refill(s)) tree.replace(s.buffer[s.position]);
+                else tree.retire();
+                if (outLength == block) {
+                    if (cancel) return false;
+                    flush(to, out.data(), outPosition, outLength);
+                }
+            }
+            flush(to, out.data(), outPosition, outLength);
+        }
+        comparisons += tree.comparisons;
+        endPhase("merge pass " + std::to_string(pass.load()));
+        return true;
+    }
+
+    MappedFile* sourceFile = nullptr; // The pass's input, for refill
+
+    // Copies the source's next block out of the mapping; false once the run is drained.
+    bool refill(MergeSource& s) {
+        int count = (int)std::min<long long>(block, s.end - s.next);
+        if (count <= 0) return false;
+        std::memcpy(s.buffer.data(), sourceFile->keys() + s.next, count * sizeof(int));
+        s.next += count;
+        s.position = 0; s.length = count;
+        noteRead(count);
+        if (opt.readAhead) sourceFile->willNeed(s.next, block);
+        return true;
+    }
+    void flush(int* to, const int* out, long long& position, int& length) {
+        std::memcpy(to + position, out, length * sizeof(int));
+        noteWritten(length);
+        updatePreview(out, position, position + length);
+        position += length;
+        written = position;
+        length = 0;
+    }
+
+    void printSummary() const {
+        double mb = 1e6;
+        std::cout << std::fixed << std::setprecision(2)
+                  << "external sort: " << n << " keys (" << n * sizeof(int) / mb << " MB), runs of " << opt.runLength
+                  << ", fan-in " << opt.fanIn << ", " << opt.ioKiB << " KiB buffers, read-ahead " << (opt.readAhead ? "on" : "off")
+                  << ", runs sorted by " << SORT_MODE_NAMES[opt.runSort] << "\n";
+        for (const PhaseStats& p : history) {
+            std::cout << "  " << p.name << ": " << p.seconds << " s, " << p.read / mb / std::max(p.seconds, 1e-9) << " MB/s read, "
+                      << p.written / mb / std::max(p.seconds, 1e-9) << " MB/s written\n";
+        }
+        std::cout << "  total: " << totalSeconds.load() << " s, " << comparisons.load() << " comparisons\n";
+    }
+};
+
+ExternalSorter externalSorter;
+
+// Returns the sort mode the bench calls `id`, or -1 for unknown names and the library sorts.
+int FindRunSort(std::string_view id) {
+    for (const auto& algo : BENCH_ALGORITHMS<int, std::less<int>>)
+        if (id == algo.id && !algo.library) return algo.mode;
+    return -1;
+}
+
+// Copies the sorter's preview into the display array, scaled onto the bar heights, and
+// reports which preview range to tint and how much of it is final. Returns true when
+// the preview changed size, which resizes the array, its bins and the bar geometry.
+bool ApplyExternalPreview(std::vector<int>& values, ArrayObserver& observer, Highlight* marks, int& markCount, int& sortedEnd) {
+    int count = externalSorter.previewCount.load(std::memory_order_acquire);
+    bool resized = (int)values.size() != std::max(count, 1);
+    if (resized) { values.assign(std::max(count, 1), MIN_VALUE); observer.onReset(); }
+    markCount = 0; sortedEnd = 0;
+    if (count == 0) return resized;
+    double low = externalSorter.minKey.load(std::memory_order_relaxed), high = externalSorter.maxKey.load(std::memory_order_relaxed);
+    double scale = high > low ? (valueRange - 1) / (high - low) : 0.0;
+    for (int i = 0; i < count; i++) {
+        double key = externalSorter.preview[i].load(std::memory_order_relaxed);
+        int v = MIN_VALUE + (int)std::clamp((key - low) * scale, 0.0, (double)(valueRange - 1));
+        if (values[i] == v) continue;
+        int old = values[i];
+        values[i] = v;
+        observer.onWrite(i, old, v);
+    }
+    long long n = std::max(externalSorter.keys.load(std::memory_order_relaxed), 1LL);
+    auto column = [&](long long position) { return (int)(position * count / n); };
+    int phase = externalSorter.phase.load(std::memory_order_relaxed), passes = externalSorter.passes.load(std::memory_order_relaxed);
+    if (phase == EXTERNAL_DONE) { sortedEnd = count; return resized; }
+    if (phase != EXTERNAL_RUNS && phase != EXTERNAL_MERGING) return resized;
+    // Only the last pass (or the runs, when one run is the whole file) writes keys in their final place
+    bool last = phase == EXTERNAL_RUNS ? passes == 0 : externalSorter.pass.load(std::memory_order_relaxed) == passes;
+    if (last) sortedEnd = column(externalSorter.written.load(std::memory_order_relaxed));
+    marks[markCount++] = {column(externalSorter.groupBegin.load()), HIGHLIGHT_LANE_0, column(externalSorter.groupEnd.load())};
+    marks[markCount++] = {std::min(column(externalSorter.written.load()), count - 1), HIGHLIGHT_WRITE};
+    return resized;
+}
+
+void FormatExternalStatus(TextBuffer& ss) {
+    const ExternalSorter& s = externalSorter;
+    int phase = s.phase.load(std::memory_order_acquire);
+    long long n = s.keys.load(std::memory_order_relaxed);
+    ss << "EXTERNAL SORT: " << externalOptions.input << " -> " << externalOptions.output << "\n"
+       << "Keys:         " << n << " (" << HumanBytes{(double)n * sizeof(int)} << "), runs of " << externalOptions.runLength
+       << " sorted by " << SORT_MODE_NAMES[externalOptions.runSort] << "\n"
+       << "Merge:        fan-in " << externalOptions.fanIn << ", " << externalOptions.ioKiB << " KiB buffers, "
+       << s.passes.load(std::memory_order_relaxed) << " pass(es), read-ahead " << (externalOptions.readAhead ? "on" : "off") << "\n"
+       << "Phase:        ";
+    switch (phase) {
+        case EXTERNAL_IDLE: ss << "mapping files"; break;
+        case EXTERNAL_GENERATING: ss << "generating input, " << s.written.load(std::memory_order_relaxed) << " keys"; break;
+        case EXTERNAL_RUNS: ss << "run generation, " << s.runsDone.load(std::memory_order_relaxed) << " / " << s.runs.load(std::memory_order_relaxed) << " runs"; break;
+        case EXTERNAL_MERGING: ss << "merge pass " << s.pass.load(std::memory_order_relaxed) << " / " << s.passes.load(std::memory_order_relaxed); break;
+        case EXTERNAL_DONE: ss << "done in " << Fixed{s.totalSeconds.load(std::memory_order_relaxed), 2} << " s (R sorts again)"; break;
+        case EXTERNAL_FAILED: ss << "failed: " << s.error; break;
+    }
+    ss << "\n";
+    double mb = 1e6;
+    if (phase == EXTERNAL_DONE) {
+        double seconds = std::max(s.totalSeconds.load(std::memory_order_relaxed), 1e-9);
+        ss << "Throughput:   " << Fixed{s.bytesRead.load(std::memory_order_relaxed) / mb / seconds, 0} << " MB/s read, "
+           << Fixed{s.bytesWritten.load(std::memory_order_relaxed) / mb / seconds, 0} << " MB/s written overall\n";
+    } else if (phase != EXTERNAL_FAILED) {
+        double seconds = std::max((double)(SDL_GetPerformanceCounter() - s.phaseStart.load(std::memory_order_relaxed)) / perfFreq, 1e-9);
+        ss << "Throughput:   " << Fixed{s.phaseBytesRead.load(std::memory_order_relaxed) / mb / seconds, 0} << " MB/s read, "
+           << Fixed{s.phaseBytesWritten.load(std::memory_order_relaxed) / mb / seconds, 0} << " MB/s written this phase\n";
+    }
+    ss << "I/O:          " << HumanBytes{(double)s.bytesRead.load(std::memory_order_relaxed)} << " read, "
+       << HumanBytes{(double)s.bytesWritten.load(std::memory_order_relaxed)} << " written\n"
+       << "Comparisons:  " << s.comparisons.load(std::memory_order_relaxed) << "\n";
+}
+
+// Parses the visualizer flags. Returns false on a malformed command line.
+bool ParseVisualizerOptions(int argc, char* argv[]) {
+    for (int k = 1; k < argc; k++) {
+        std::string_view arg = argv[k];
+        bool hasValue = k + 1 < argc;
+        if (arg == "--n" && hasValue) numElements = std::clamp(std::atoi(argv[++k]), 2, MAX_NUM_ELEMENTS);
+        else if (arg == "--range" && hasValue) valueRange = std::clamp(std::atoi(argv[++k]), 1, MAX_VALUE_RANGE);
+        else if (arg == "--dist" && hasValue) {
+            int dist = FindInputDistribution(argv[++k]);
+            if (dist < 0) { std::cerr << "Unknown distribution: " << argv[k] << "\n"; return false; }
+            inputDistribution = (InputDistribution)dist;
+        }
+        else if (arg == "--swaps" && hasValue) nearlySortedSwaps = std::max(0, std::atoi(argv[++k]));
+        else if (arg == "--frame-trace" && hasValue) frameTracePath = argv[++k];
+        else if (arg == "--target-seconds" && hasValue) { paceToTarget = true; targetSeconds = std::clamp(std::atof(argv[++k]), MIN_TARGET_SECONDS, MAX_TARGET_SECONDS); }
+        else if (arg == "--load" && hasValue) loadPath = argv[++k];
+        else if (arg == "--seed" && hasValue) SeedRandom(std::strtoull(argv[++k], nullptr, 0));
+        else if (arg == "--save-prefix" && hasValue) savePrefix = argv[++k];
+        else if (arg == "--compress") compressSaves = true;
+        else if (arg == "--external" && hasValue) { externalMode = true; externalOptions.input = argv[++k]; }
+        else if (arg == "--external-out" && hasValue) externalOptions.output = argv[++k];
+        else if (arg == "--external-generate" && hasValue) externalOptions.generate = std::max(0LL, std::atoll(argv[++k]));
+        else if (arg == "--run-length" && hasValue) externalOptions.runLength = std::clamp(std::atoi(argv[++k]), 2, MAX_NUM_ELEMENTS);
+        else if (arg == "--fan-in" && hasValue) externalOptions.fanIn = std::clamp(std::atoi(argv[++k]), 2, 1024);
+        else if (arg == "--io-kb" && hasValue) externalOptions.ioKiB = std::clamp(std::atoi(argv[++k]), 4, 1 << 20);
+        else if (arg == "--no-readahead") externalOptions.readAhead = false;
+        else if (arg == "--run-sort" && hasValue) {
+            int mode = FindRunSort(argv[++k]);
+            if (mode < 0) { std::cerr << "Unknown run sort: " << argv[k] << "\n"; return false; }
+            externalOptions.runSort = (SortMode)mode;
+        }
+        else {
+            std::cerr << "Unknown or incomplete option: " << arg << "\n"
+                      << "Usage: [--n 150] [--range 100] [--dist random] [--swaps K] [--seed S] [--target-seconds 10] [--frame-trace out.json]\n"
+                      << "       [--load array-or-trace.svz] [--save-prefix capture] [--compress]\n"
+                      << "       --external keys.bin [--external-out sorted.bin] [--external-generate N] [--run-length 1048576]\n"
+                      << "                  [--fan-in 16] [--io-kb 1024] [--no-readahead] [--run-sort pdq]\n"
+                      << "       --bench [options]\n";
+            return false;
+        }
+    }
+    if (externalOptions.output.empty()) externalOptions.output = externalOptions.input + ".sorted";
+    return true;
 }
 
 int main(int argc, char* argv[]) {
-    srand(time(NULL));
+    SeedRandom((uint64_t)std::random_device{}() << 32 | std::random_device{}()); // --seed replaces it
+
+    for (int k = 1; k < argc; k++) {
+        if (std::string_view(argv[k]) == "--bench") {
+            BenchOptions opt;
+            if (!ParseBenchOptions(argc, argv, opt)) return 1;
+            return RunBenchmarks(opt);
+        }
+    }
+    if (!ParseVisualizerOptions(argc, argv)) return 1;
+    DataFile loaded;
+    if (!loadPath.empty()) {
+        std::string error;
+        if (!LoadDataFile(loadPath, loaded, error) || !FitLoadedFile(loaded, error)) { std::cerr << error << "\n"; return 1; }
+        if (loaded.header.kind == DATA_ARRAY) loadedInput = std::move(loaded.values);
+    }
+
     if (!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO)) return 1;
 
     // Get CPU Frequency for accurate timing
@@ -201,19 +3014,63 @@ int main(int argc, char* argv[]) {
 
     SDL_AudioSpec spec;
     spec.channels = 1; spec.format = SDL_AUDIO_F32; spec.freq = SAMPLE_RATE;
-    SDL_AudioStream* stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, AudioCallback, nullptr);
+    SDL_AudioStream* stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, AudioCallback, &audioMixer);
     if (stream) SDL_ResumeAudioDevice(SDL_GetAudioStreamDevice(stream));
 
     SDL_Window* window = nullptr;
     SDL_Renderer* renderer = nullptr;
     SDL_CreateWindowAndRenderer("Algorithm Visualizer!", WINDOW_WIDTH, WINDOW_HEIGHT, 0, &window, &renderer);
+    SDL_SetRenderVSync(renderer, 1); // Pacing comes from the step scheduler, not from delays
 
-    ResetSort(BUBBLE_SORT, true);
+    displayObservers.add(&columnBins);
+    displayObservers.add(&sortedness);
+    displayObservers.add(&inversionCounter);
+
+    if (externalMode) {
+        externalSorter.start(externalOptions, inputRng);
+        externalOptions.generate = 0; // R sorts the same file again
+    } else {
+        ApplyControls();
+        worker.start();
+        if (loaded.header.kind == DATA_TRACE) ReplayLoadedTrace(loaded);
+        else ResetSort(BUBBLE_SORT, true);
+    }
+
+    BarGeometry barGeometry;
+    CachedText headerCache;
+    Uint64 lastFrameTick = SDL_GetPerformanceCounter();
 
     SDL_Event event;
+    int quietFrames = 0;  // Frames since the last event
+#ifndef NDEBUG
+    unsigned long long frameAllocations = threadAllocations;
+#endif
     while (isRunning) {
+#ifndef NDEBUG
+        // Input can allocate (new arrays, race panes), and so can the frames that pick
+        // up a resized array; once those have settled, a frame must not.
+        SDL_assert(quietFrames <= ALLOCATION_WARMUP_FRAMES || threadAllocations == frameAllocations);
+        frameAllocations = threadAllocations;
+#endif
+        quietFrames++;
+        profiler.beginFrame();
         while (SDL_PollEvent(&event)) {
+            quietFrames = 0;
             if (event.type == SDL_EVENT_QUIT) isRunning = false;
+            // Render-target textures lose their contents, or on a device reset the textures themselves
+            if (event.type == SDL_EVENT_RENDER_TARGETS_RESET) {
+                barGeometry.invalidate(); headerCache.invalidate();
+                for (auto& pane : racePanes) pane->geometry.invalidate();
+            }
+            if (event.type == SDL_EVENT_RENDER_DEVICE_RESET) {
+                barGeometry.releaseLayer(); headerCache.release();
+                for (auto& pane : racePanes) pane->geometry.releaseLayer();
+            }
+            if (event.type == SDL_EVENT_KEY_DOWN && externalMode) {
+                // Only restarting, the profiler and quitting apply to the file sort
+                if (event.key.key == SDLK_R) externalSorter.start(externalOptions, inputRng);
+                else if (event.key.key != SDLK_F && event.key.key != SDLK_ESCAPE) continue;
+            }
             if (event.type == SDL_EVENT_KEY_DOWN) {
                 switch (event.key.key) {
                     case SDLK_1: ResetSort(BUBBLE_SORT, true); break;
@@ -221,175 +3078,240 @@ int main(int argc, char* argv[]) {
                     case SDLK_3: ResetSort(INSERTION_SORT, true); break;
                     case SDLK_4: ResetSort(QUICK_SORT, true); break;
                     case SDLK_5: ResetSort(MERGE_SORT, true); break;
+                    case SDLK_6: ResetSort(PARALLEL_MERGE_SORT, true); break;
+                    case SDLK_7: ResetSort(PARALLEL_QUICK_SORT, true); break;
+                    case SDLK_8: ResetSort(INTRO_SORT, true); break;
+                    case SDLK_9: ResetSort(PDQ_SORT, true); break;
+                    case SDLK_0: ResetSort(TIM_SORT, true); break;
+                    case SDLK_TAB: { // Steps through every algorithm, including those without a number key
+                        int step = (event.key.mod & SDL_KMOD_SHIFT) ? NUM_SORT_MODES - 1 : 1;
+                        ResetSort((SortMode)((currentMode + step) % NUM_SORT_MODES), true);
+                        break;
+                    }
                     case SDLK_R: ResetSort(currentMode, false); break;
-                    case SDLK_ESCAPE: isRunning = false;
-                    case SDLK_UP: if(currentDelay > 0) currentDelay--; break;
-                    case SDLK_DOWN: currentDelay++; break;
-                }
-            }
-        }
-
-        // --- UPDATE LOOP ---
-        int soundVal = 0;
-
-        // 1. Shuffling Logic
-        if (isShuffling) {
-            if (shuffle_i < data.size()) {
-                int rIdx = rand() % data.size();
-                std::swap(data[shuffle_i], data[rIdx]);
-                soundVal = data[shuffle_i]; shuffle_i++;
-                SDL_Delay(DELAY_SHUFFLE);
-            } else { PrepareForSort(); }
-        }
-            // 2. Sorting Logic (WITH ACCURATE TIMING)
-        else if (!isSorted) {
-
-            // --- START STOPWATCH ---
-            Uint64 startTick = SDL_GetPerformanceCounter();
-
-            if (currentMode == BUBBLE_SORT) {
-                soundVal = data[j+1]; comparisons++;
-                if (data[j] > data[j+1]) { std::swap(data[j], data[j+1]); swaps++; }
-                j++; if (j >= data.size() - 1 - i) { j = 0; i++; if (i >= data.size() - 1) isSorted = true; }
-
-            } else if (currentMode == SELECTION_SORT) {
-                soundVal = data[j]; comparisons++;
-                if (data[j] < data[minIdx]) minIdx = j;
-                j++; if (j >= data.size()) { std::swap(data[i], data[minIdx]); swaps++; i++; j = i + 1; minIdx = i; if (i >= data.size() - 1) isSorted = true; }
-
-            } else if (currentMode == INSERTION_SORT) {
-                soundVal = data[j]; comparisons++;
-                if (j > 0 && data[j] < data[j-1]) { std::swap(data[j], data[j-1]); swaps++; j--; }
-                else { i++; j = i; if (i >= data.size()) isSorted = true; }
-
-            } else if (currentMode == QUICK_SORT) {
-                if (!qs_partitionMode) {
-                    if (qsStack.empty()) { isSorted = true; } else { auto range = qsStack.back(); qsStack.pop_back(); qs_l = range.first; qs_r = range.second; qs_i = qs_l - 1; qs_j = qs_l; qs_partitionMode = true; }
-                } else {
-                    soundVal = data[qs_j];
-                    if (qs_j < qs_r) { comparisons++; if (data[qs_j] < data[qs_r]) { qs_i++; std::swap(data[qs_i], data[qs_j]); swaps++; } qs_j++; } else { std::swap(data[qs_i + 1], data[qs_r]); swaps++; int p = qs_i + 1; if (p + 1 < qs_r) qsStack.push_back({p + 1, qs_r}); if (qs_l < p - 1) qsStack.push_back({qs_l, p - 1}); qs_partitionMode = false; }
-                }
-
-            } else if (currentMode == MERGE_SORT) {
-                if (!ms_copying) {
-                    if (ms_curr_size >= data.size()) { isSorted = true; }
-                    else if (ms_left_start >= data.size() - 1) { ms_curr_size *= 2; ms_left_start = 0; }
-                    else { ms_l = ms_left_start; ms_m = std::min(ms_left_start + ms_curr_size - 1, (int)data.size() - 1); ms_r = std::min(ms_left_start + 2 * ms_curr_size - 1, (int)data.size() - 1); ms_i = ms_l; ms_j = ms_m + 1; ms_k = ms_l; for(int x = ms_l; x <= ms_r; x++) ms_temp[x] = data[x]; ms_copying = true; }
-                } else {
-                    if (ms_k <= ms_r) {
-                        comparisons++;
-                        if (ms_i <= ms_m && (ms_j > ms_r || ms_temp[ms_i] <= ms_temp[ms_j])) { data[ms_k] = ms_temp[ms_i]; soundVal = ms_temp[ms_i]; ms_i++; }
-                        else { data[ms_k] = ms_temp[ms_j]; soundVal = ms_temp[ms_j]; ms_j++; }
-                        swaps++; ms_k++;
+                    case SDLK_I: { // Next/previous input distribution, on a freshly generated array
+                        int step = (event.key.mod & SDL_KMOD_SHIFT) ? NUM_INPUT_DISTRIBUTIONS - 1 : 1;
+                        inputDistribution = (InputDistribution)((inputDistribution + step) % NUM_INPUT_DISTRIBUTIONS);
+                        loadedInput.clear();
+                        ResetSort(currentMode, true);
+                        break;
                     }
-                    else { ms_copying = false; ms_left_start += 2 * ms_curr_size; }
+                    case SDLK_T:
+                        if (!isShuffling) { replayEnabled = !replayEnabled; PrepareForSort(); }
+                        break;
+                    case SDLK_N:
+                        if (!isShuffling) { networkLeaves = !networkLeaves; PrepareForSort(); }
+                        break;
+                    case SDLK_H: // Sorts the same input again, so the counters cover the whole run
+                        if (!isShuffling) { hardwareCounters = !hardwareCounters; PrepareForSort(); }
+                        break;
+                    case SDLK_A: if (raceMode) { LeaveRaceMode(); ResetSort(currentMode, true); } else EnterRaceMode(); break;
+                    case SDLK_HOME: RequestRewind(); break;
+                    case SDLK_SPACE: replayPaused = !replayPaused; ApplyControls(); break;
+                    case SDLK_LEFT: replayDirection = -1; replayPaused = false; ApplyControls(); break;
+                    case SDLK_RIGHT: replayDirection = 1; replayPaused = false; ApplyControls(); break;
+                    case SDLK_LEFTBRACKET: numElements = std::max(numElements / 2, 2); loadedInput.clear(); ResetSort(currentMode, true); break;
+                    case SDLK_RIGHTBRACKET: numElements = std::min(numElements * 2, MAX_NUM_ELEMENTS); loadedInput.clear(); ResetSort(currentMode, true); break;
+                    case SDLK_MINUS: valueRange = std::max(valueRange / 2, 1); loadedInput.clear(); ResetSort(currentMode, true); break;
+                    case SDLK_EQUALS: valueRange = std::min(valueRange * 2, MAX_VALUE_RANGE); loadedInput.clear(); ResetSort(currentMode, true); break;
+                    case SDLK_S:
+                        if (event.key.mod & SDL_KMOD_SHIFT) {
+                            if (!raceMode) worker.saveTrace(savePrefix + ".trace.svz", compressSaves);
+                        } else {
+                            std::string error, path = savePrefix + ".array.svz";
+                            if (SaveArray(path, raceMode ? racePanes[0]->values : data, compressSaves, error)) std::cout << "Saved the array to " << path << "\n";
+                            else std::cerr << error << "\n";
+                        }
+                        break;
+                    case SDLK_P: progressMetric = (ProgressMetric)((progressMetric + 1) % 3); break;
+                    case SDLK_G: columnAggregate = columnAggregate == AGGREGATE_MIN_MAX ? AGGREGATE_MEAN : AGGREGATE_MIN_MAX; break;
+                    case SDLK_M: showHeatmap = !showHeatmap; break;
+                    case SDLK_F:
+                        if (!(event.key.mod & SDL_KMOD_SHIFT)) showProfiler = !showProfiler;
+                        else if (profiler.writeTrace(frameTracePath)) std::cout << "Wrote frame trace to " << frameTracePath << "\n";
+                        else std::cerr << "Could not write " << frameTracePath << "\n";
+                        break;
+                    case SDLK_ESCAPE: isRunning = false; break;
+                    case SDLK_D: paceToTarget = !paceToTarget; ApplyControls(); break;
+                    case SDLK_UP:
+                        if (paceToTarget) targetSeconds = std::max(targetSeconds / SPEED_FACTOR, MIN_TARGET_SECONDS);
+                        else stepsPerSecond = std::min(stepsPerSecond * SPEED_FACTOR, MAX_STEPS_PER_SECOND);
+                        ApplyControls();
+                        break;
+                    case SDLK_DOWN:
+                        if (paceToTarget) targetSeconds = std::min(targetSeconds * SPEED_FACTOR, MAX_TARGET_SECONDS);
+                        else stepsPerSecond = std::max(stepsPerSecond / SPEED_FACTOR, MIN_STEPS_PER_SECOND);
+                        ApplyControls();
+                        break;
                 }
             }
+        }
 
-            // --- STOP STOPWATCH ---
-            Uint64 endTick = SDL_GetPerformanceCounter();
-
-            // Calculate strictly the time taken for logic (nanoseconds converted to ms)
-            double frameTimeMs = (double)((endTick - startTick) * 1000) / perfFreq;
-            preciseTimeMs += frameTimeMs;
+        profiler.mark(PHASE_EVENTS);
+        unsigned underruns = audioMixer.underruns.load(std::memory_order_relaxed);
+
+        if (externalMode) {
+            Highlight marks[2];
+            int markCount = 0, sortedEnd = 0;
+            // The preview fills in once the input is on disk, which can be long after any
+            // input event; the frames that pick up the new size may allocate, as after one
+            if (ApplyExternalPreview(data, displayObservers, marks, markCount, sortedEnd)) quietFrames = 0;
+            profiler.mark(PHASE_STEPPING);
+
+            SDL_SetRenderDrawColor(renderer, 10, 12, 20, 255);
+            SDL_RenderClear(renderer);
+            columnBins.refresh();
+            barGeometry.update(columnBins, MaxValue(), columnAggregate, 0, sortedEnd, marks, markCount);
+            barGeometry.draw(renderer);
+            profiler.mark(PHASE_GEOMETRY);
+
+            TextBuffer ss;
+            FormatExternalStatus(ss);
+            RenderUI(renderer, ss.view());
+            if (showProfiler) profiler.draw(renderer, WINDOW_WIDTH - PROFILE_OVERLAY_WIDTH - 20.0f, 20.0f);
+            profiler.mark(PHASE_UI);
+            SDL_RenderPresent(renderer);
+            profiler.mark(PHASE_PRESENT);
+            profiler.endFrame(0.0, underruns);
+            continue;
+        }
 
-            // --- ARTIFICIAL DELAY (Happens AFTER stopwatch stops) ---
-            if (currentMode == MERGE_SORT && ms_copying) SDL_Delay(currentDelay + 2);
-            else SDL_Delay(currentDelay);
+        if (raceMode) {
+            UpdateRacePanes();
+            isShuffling = false;
+            for (auto& pane : racePanes) isShuffling |= pane->worker.snapshots.front().task == TASK_SHUFFLE;
+            profiler.mark(PHASE_STEPPING);
+
+            SDL_SetRenderDrawColor(renderer, 10, 12, 20, 255);
+            SDL_RenderClear(renderer);
+            RenderRacePanes(renderer);
+            profiler.mark(PHASE_GEOMETRY);
+
+            TextBuffer ss;
+            ss << "RACE: " << racePanes[0]->values.size() << " elements, " << (paceToTarget ? "paced to " : "") << Fixed{paceToTarget ? targetSeconds : stepsPerSecond, paceToTarget ? 1 : 0} << (paceToTarget ? " s each" : " steps/s each") << (replayEnabled ? ", replay" : ", live") << ", seed " << randomSeed;
+            RenderUI(renderer, ss.view());
+            if (showProfiler) profiler.draw(renderer, WINDOW_WIDTH - PROFILE_OVERLAY_WIDTH - 20.0f, 60.0f);
+            profiler.mark(PHASE_UI);
+            SDL_RenderPresent(renderer);
+            profiler.mark(PHASE_PRESENT);
+            double raceRate = 0.0;
+            for (auto& pane : racePanes) raceRate += pane->worker.measuredRate.load(std::memory_order_relaxed);
+            profiler.endFrame(raceRate, underruns);
+            continue;
         }
 
-        targetHeight.store(soundVal);
+        // --- UPDATE LOOP ---
+        // All stepping happens on the worker; the frame just catches up with its latest snapshot.
+        worker.snapshots.acquire();
+        const SortSnapshot& view = worker.snapshots.front();
+        ApplySnapshot(view, data, appliedVersions, displayObservers);
+        isShuffling = view.task == TASK_SHUFFLE;
+        isSorted = view.task == TASK_SORT && view.done;
+        unsigned long long comparisons = worker.comparisons.load(std::memory_order_relaxed);
+        unsigned long long swaps = worker.swaps.load(std::memory_order_relaxed);
+
+        sortedness.refresh();
+        if (progressMetric == PROGRESS_INVERSIONS && !isShuffling) inversionCounter.advance();
+        profiler.mark(PHASE_STEPPING);
 
         // --- RENDER ---
         SDL_SetRenderDrawColor(renderer, 10, 12, 20, 255);
         SDL_RenderClear(renderer);
 
-        RenderProgressBar(renderer);
+        RenderProgressBar(renderer, view, comparisons);
 
-        float barWidth = (float)WINDOW_WIDTH / data.size();
-        float barBottomY = WINDOW_HEIGHT - 30.0f;
-
-        for (int k = 0; k < data.size(); k++) {
-            float h = (float)data[k] * 7.0f;
-            SetBlueGradientColor(renderer, data[k], 100);
-
-            if (isSorted) {
-                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-            }
-            else {
-                if (currentMode == BUBBLE_SORT && k >= data.size() - i) SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-                else if (currentMode == SELECTION_SORT && k < i) SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-            }
+        int sortedBegin = view.sortedBegin, sortedEnd = view.sortedEnd;
+        if (isSorted) { sortedBegin = 0; sortedEnd = data.size(); }
 
-            if (isShuffling) {
-                if (k == shuffle_i) SDL_SetRenderDrawColor(renderer, 255, 50, 50, 255);
-            }
-            else if (!isSorted) {
-                if (currentMode == BUBBLE_SORT) { if(k==j || k==j+1) SDL_SetRenderDrawColor(renderer, 255, 50, 50, 255); }
-                else if (currentMode == SELECTION_SORT) { if(k==j) SDL_SetRenderDrawColor(renderer, 255, 50, 50, 255); if(k==minIdx) SDL_SetRenderDrawColor(renderer, 255, 0, 255, 255); }
-                else if (currentMode == INSERTION_SORT) { if(k==j) SDL_SetRenderDrawColor(renderer, 255, 50, 50, 255); }
-                else if (currentMode == QUICK_SORT) { if(k==qs_j) SDL_SetRenderDrawColor(renderer, 255, 50, 50, 255); if(k==qs_r) SDL_SetRenderDrawColor(renderer, 255, 0, 255, 255); }
-                else if (currentMode == MERGE_SORT) { if(ms_copying && k == ms_k - 1) SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255); }
-            }
+        Uint64 frameTick = SDL_GetPerformanceCounter();
+        heatmap.update(view.heatReads, view.heatWrites, (double)(frameTick - lastFrameTick) / perfFreq);
+        lastFrameTick = frameTick;
+        if (showHeatmap) heatmap.draw(renderer);
 
-            SDL_FRect bar = { k * barWidth, barBottomY - h, barWidth - 1, h };
-            SDL_RenderFillRect(renderer, &bar);
-        }
+        columnBins.refresh();
+        barGeometry.update(columnBins, MaxValue(), columnAggregate, sortedBegin, sortedEnd, view.marks, view.markCount);
+        barGeometry.draw(renderer);
+        profiler.mark(PHASE_GEOMETRY);
 
         // --- RENDER UI ---
-        std::stringstream ss;
-        std::string algoName, complexity, desc;
-
-        switch(currentMode) {
-            case BUBBLE_SORT:
-                algoName = "Bubble Sort";
-                complexity = "O(N^2) - Slow";
-                desc = "Swaps adjacent elements repeatedly.";
-                break;
-            case SELECTION_SORT:
-                algoName = "Selection Sort";
-                complexity = "O(N^2) - Slow";
-                desc = "Finds the smallest item and moves it.";
-                break;
-            case INSERTION_SORT:
-                algoName = "Insertion Sort";
-                complexity = "O(N^2) - OK for small lists";
-                desc = "Builds sorted array one item at a time.";
-                break;
-            case QUICK_SORT:
-                algoName = "Quick Sort";
-                complexity = "O(N log N) - Fast";
-                desc = "Divides list around a pivot point.";
-                break;
-            case MERGE_SORT:
-                algoName = "Merge Sort";
-                complexity = "O(N log N) - Stable";
-                desc = "Divides list in half, sorts, and merges.";
-                break;
-        }
+        // Formatted into fixed buffers; the header only changes with the algorithm, so
+        // it lives in a cached texture
+        TextBuffer header, ss;
+        const AlgorithmInfo& info = ALGORITHM_INFO[currentMode];
+        header << "ALGORITHM:  " << SORT_MODE_NAMES[currentMode] << "\nCOMPLEXITY: " << info.complexity
+               << "\nHOW IT WORKS: " << info.description << "\n\n";
+        float statsTop = 20.0f;
 
         if(isShuffling) {
             ss << "STATUS: Shuffling...";
         } else {
-            // Use std::fixed and std::setprecision for readable decimals
+            statsTop += headerCache.draw(renderer, header.view(), 20.0f, 20.0f);
             ss.precision(3);
-            ss << std::fixed;
 
-            ss << "ALGORITHM:  " << algoName << "\n"
-               << "COMPLEXITY: " << complexity << "\n"
-               << "HOW IT WORKS: " << desc << "\n\n"
+            ss << "Elements:     " << data.size() << " (values " << MIN_VALUE << ".." << MaxValue() << ")\n"
+               << "Input:        " << (loadedInput.empty() ? std::string_view(INPUT_DISTRIBUTION_NAMES[inputDistribution]) : std::string_view(loadPath)) << "\n"
+               << "Seed:         " << randomSeed << "\n"
                << "Comparisons:  " << comparisons << "\n"
                << "Swaps:        " << swaps << "\n"
-               << "Real CPU Time:" << preciseTimeMs << "ms\n"
-               << "Delay Added:  " << currentDelay << "ms";
+               << "Sorted Pairs: " << sortedness.sorted() << " / " << sortedness.pairs() << "\n";
+            if (progressMetric == PROGRESS_INVERSIONS) ss << "Inversions:   " << inversionCounter.count() << "\n";
+            ss << "Progress Bar: "
+               << (progressMetric == PROGRESS_ALGORITHM ? "algorithm" : progressMetric == PROGRESS_SORTED_PAIRS ? "sorted pairs" : "inversions") << "\n"
+               << "Real CPU Time:" << worker.cpuTimeMs.load(std::memory_order_relaxed) << "ms" << (view.replaying ? " (recorded run)" : "") << "\n"
+               << "Speed:        ";
+            if (paceToTarget)
+                ss << Fixed{worker.pacedRate.load(std::memory_order_relaxed), 1} << " steps/s to finish in " << Fixed{targetSeconds, 1} << " s (~"
+                   << HumanCount{worker.estimatedSteps.load(std::memory_order_relaxed)} << " steps, ";
+            else
+                ss << Fixed{stepsPerSecond, 0} << " steps/s (";
+            ss << Fixed{worker.measuredRate.load(std::memory_order_relaxed), 0} << " measured)\n";
+            if (currentMode == GPU_BITONIC_SORT) ss << "GPU:          " << gpuCompute.status() << "\n";
+            if (UsesNetworkLeaves(currentMode))
+                ss << "Small Ranges: " << (networkLeaves ? "sorting network (8/16/32)" : "insertion sort") << "\n";
+            ss << "Memory Model: " << HumanBytes{(double)worker.bytesRead.load(std::memory_order_relaxed)} << " read, "
+               << HumanBytes{(double)worker.bytesWritten.load(std::memory_order_relaxed)} << " written\n";
+            double auxBytes = (double)worker.peakAuxBytes.load(std::memory_order_relaxed);
+            ss << "Aux Memory:   " << HumanBytes{auxBytes} << " peak (" << Fixed{100.0 * auxBytes / std::max<size_t>(data.size() * sizeof(int), 1), 1}
+               << "% of the array)\n";
+            if (hardwareCounters) {
+                unsigned valid = worker.hardwareValid.load(std::memory_order_relaxed);
+                auto counter = [&](int c) -> TextBuffer& {
+                    if (!(valid >> c & 1)) return ss << '-';
+                    return ss << HumanCount{(double)worker.hardware[c].load(std::memory_order_relaxed)};
+                };
+                if (worker.countersUnavailable.load(std::memory_order_relaxed)) {
+                    ss << "HW Counters:  unavailable (perf_event_open)\n";
+                } else {
+                    ss << "HW Counters:  "; counter(HW_CYCLES) << " cycles, "; counter(HW_INSTRUCTIONS) << " instructions";
+                    double cycles = (double)worker.hardware[HW_CYCLES].load(std::memory_order_relaxed);
+                    if ((valid & 3) == 3 && cycles > 0) ss << " (IPC " << Fixed{worker.hardware[HW_INSTRUCTIONS].load(std::memory_order_relaxed) / cycles, 2} << ")";
+                    ss << "\n              misses "; counter(HW_L1D_MISSES) << " L1D, "; counter(HW_LLC_MISSES) << " LLC, ";
+                    counter(HW_BRANCH_MISSES) << " branch\n";
+                }
+            }
+            if (view.replaying) {
+                ss << "Replay:       op " << view.replayPosition << " / " << view.traceSize
+                   << (replayPaused ? "  [paused]" : replayDirection < 0 ? "  [reverse]" : "");
+            } else {
+                ss << "Replay:       off" << (!replayEnabled ? " (live stepping)" : currentMode == GPU_BITONIC_SORT ? " (GPU passes, stepping live)" : " (trace too large, stepping live)");
+            }
         }
 
-        RenderUI(renderer, ss.str());
+        RenderUI(renderer, ss.view(), 20.0f, statsTop);
+        if (showProfiler) profiler.draw(renderer, WINDOW_WIDTH - PROFILE_OVERLAY_WIDTH - 20.0f, 20.0f);
+        profiler.mark(PHASE_UI);
 
         SDL_RenderPresent(renderer);
+        profiler.mark(PHASE_PRESENT);
+        profiler.endFrame(worker.measuredRate.load(std::memory_order_relaxed), underruns);
     }
 
+    racePanes.clear();
+    externalSorter.stop();
+    worker.stop();
+    gpuCompute.shutdown();
     if (stream) SDL_DestroyAudioStream(stream);
+    barGeometry.releaseLayer(); headerCache.release(); // Their textures die with the renderer
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
@@ -0,0 +1,200 @@
+// The parts of sortcore.h that are not inline: its globals and the larger free functions.
+#include "sortcore.h"
+
+// --- SORTING NETWORKS ---
+bool networkLeaves = false;
+
+// --- IN-PLACE SORTS ---
+int ShellGaps(SortMode sequence, int n, int* gaps) {
+    const int CIURA[] = {1, 4, 10, 23, 57, 132, 301, 701};
+    int count = 0;
+    if (sequence == SHELL_SORT_HALVING) {
+        for (int h = n / 2; h > 0; h /= 2) gaps[count++] = h;
+        return count;
+    }
+    for (long long h = 1; h < n && count < MAX_SHELL_GAPS; ) {
+        gaps[count++] = (int)h;
+        if (sequence == SHELL_SORT_KNUTH) h = 3 * h + 1;
+        else h = count < (int)std::size(CIURA) ? CIURA[count] : (long long)(h * 2.25);
+    }
+    std::reverse(gaps, gaps + count);
+    return count;
+}
+
+// --- NON-COMPARISON SORTS ---
+void ValueBounds(const std::vector<int>& values, int& lo, int& hi) {
+    lo = values.empty() ? 0 : values[0]; hi = lo;
+    for (int v : values) { lo = std::min(lo, v); hi = std::max(hi, v); }
+}
+
+// --- GPU COMPUTE ---
+GpuCompute gpuCompute;
+
+// --- STEPPER FACTORY ---
+bool UsesNetworkLeaves(SortMode mode) {
+    return mode == QUICK_SORT || mode == MERGE_SORT || mode == PARALLEL_MERGE_SORT || mode == INTRO_SORT || mode == PDQ_SORT || mode == MSD_RADIX_SORT;
+}
+
+std::unique_ptr<SortStepper> CreateStepper(SortMode mode, std::vector<int>& values, ScratchArena& arena, bool networkLeaves) {
+    // Counting sort needs a bucket per value on top of the per-element scratch
+    int minValue = 0, maxValue = 0;
+    if (mode == COUNTING_SORT) {
+        ValueBounds(values, minValue, maxValue);
+        if ((long long)maxValue - minValue >= COUNTING_MAX_BUCKETS) mode = LSD_RADIX_SORT;
+    }
+    arena.reset(values.size(), mode == COUNTING_SORT ? (size_t)(maxValue - minValue + 1) * sizeof(int) : 0);
+    switch (mode) {
+        case BUBBLE_SORT: return std::make_unique<BubbleSortStepper>(values);
+        case SELECTION_SORT: return std::make_unique<SelectionSortStepper>(values);
+        case INSERTION_SORT: return std::make_unique<InsertionSortStepper>(values);
+        case QUICK_SORT: return std::make_unique<QuickSortStepper>(values, arena, networkLeaves);
+        case MERGE_SORT: return std::make_unique<MergeSortStepper>(values, arena, networkLeaves);
+        case PARALLEL_MERGE_SORT: return std::make_unique<ParallelMergeSortStepper>(values, arena, networkLeaves);
+        case PARALLEL_QUICK_SORT: return std::make_unique<ParallelQuickSortStepper>(values);
+        case INTRO_SORT: return std::make_unique<IntroSortStepper>(values, arena, networkLeaves);
+        case PDQ_SORT: return std::make_unique<PdqSortStepper>(values, arena, networkLeaves);
+        case TIM_SORT: return std::make_unique<TimSortStepper>(values, arena);
+        case COUNTING_SORT: return std::make_unique<CountingSortStepper>(values, arena, minValue, maxValue);
+        case LSD_RADIX_SORT: return std::make_unique<LsdRadixSortStepper>(values, arena);
+        case MSD_RADIX_SORT: return std::make_unique<MsdRadixSortStepper>(values, arena, networkLeaves);
+        case BITONIC_SORT: return std::make_unique<BitonicSortStepper>(values);
+        case GPU_BITONIC_SORT: return std::make_unique<GpuBitonicSortStepper>(values);
+        case HEAP_SORT: return std::make_unique<HeapSortStepper>(values);
+        case IN_PLACE_MERGE_SORT: return std::make_unique<InPlaceMergeSortStepper>(values);
+        case SHELL_SORT_CIURA: case SHELL_SORT_KNUTH: case SHELL_SORT_HALVING: return std::make_unique<ShellSortStepper>(values, mode);
+    }
+    return nullptr;
+}
+
+// --- INPUT DISTRIBUTIONS ---
+int nearlySortedSwaps = 0;
+
+int FindInputDistribution(std::string_view name) {
+    for (int d = 0; d < NUM_INPUT_DISTRIBUTIONS; d++) if (name == INPUT_DISTRIBUTION_NAMES[d]) return d;
+    return -1;
+}
+
+void GenerateMedian3Killer(std::vector<int>& out, int range) {
+    int n = out.size();
+    const int GAS = n;  // Undecided: larger than every fixed value
+    std::vector<int> val(n, GAS), ids(n);
+    for (int k = 0; k < n; k++) ids[k] = k;
+    int solid = 0, candidate = 0;
+    auto less = [&](int a, int b) {
+        int x = ids[a], y = ids[b];
+        if (val[x] == GAS && val[y] == GAS) val[x == candidate ? x : y] = solid++;
+        if (val[x] == GAS) candidate = x;
+        else if (val[y] == GAS) candidate = y;
+        return val[x] < val[y];
+    };
+    auto sort2 = [&](int a, int b) { if (less(b, a)) std::swap(ids[a], ids[b]); };
+    struct Task { int lo, hi, depth; };
+    std::vector<Task> stack;
+    if (n > 1) stack.push_back({0, n - 1, 2 * FloorLog2(n)});
+    while (!stack.empty()) {
+        auto [l, r, depth] = stack.back(); stack.pop_back();
+        int size = r - l + 1;
+        if (size <= INTRO_INSERTION_CUTOFF || depth == 0) continue;
+        int mid = l + size / 2;
+        sort2(l, mid); sort2(mid, r); sort2(l, mid);
+        std::swap(ids[mid], ids[r]);
+        int i = l - 1;
+        for (int j = l; j < r; j++) if (less(j, r)) { i++; std::swap(ids[i], ids[j]); }
+        std::swap(ids[i + 1], ids[r]);
+        int p = i + 1;
+        if (p + 1 < r) stack.push_back({p + 1, r, depth - 1});
+        if (l < p - 1) stack.push_back({l, p - 1, depth - 1});
+    }
+    for (int& v : val) if (v == GAS) v = solid++;
+    // Ranks spread over the span, which is at least N so ties can't undo the adversary
+    int span = InputSpan(INPUT_MEDIAN3_KILLER, n, range);
+    for (int k = 0; k < n; k++) out[k] = MIN_VALUE + (int)((long long)val[k] * span / n);
+}
+
+int InputSpan(InputDistribution dist, int n, int range) {
+    return dist == INPUT_MEDIAN3_KILLER ? std::max(range, n) : range;
+}
+
+void GenerateInput(InputDistribution dist, std::vector<int>& out, int n, int range, Xoshiro256& rng) {
+    out.resize(n);
+    auto uniform = [&] { return MIN_VALUE + (int)rng.below((uint32_t)range); };
+    switch (dist) {
+        case INPUT_RANDOM:
+            for (int& v : out) v = uniform();
+            break;
+        case INPUT_SORTED: case INPUT_REVERSED: case INPUT_NEARLY_SORTED:
+            for (int& v : out) v = uniform();
+            std::sort(out.begin(), out.end());
+            if (dist == INPUT_REVERSED) std::reverse(out.begin(), out.end());
+            if (dist == INPUT_NEARLY_SORTED && n > 1) {
+                int swaps = nearlySortedSwaps > 0 ? nearlySortedSwaps : std::max(1, n / 100);
+                for (int s = 0; s < swaps; s++) std::swap(out[rng.below(n)], out[rng.below(n)]);
+            }
+            break;
+        case INPUT_FEW_UNIQUE:
+            for (int& v : out) v = MIN_VALUE + (int)rng.below(FEW_UNIQUE_VALUES) * (range / FEW_UNIQUE_VALUES);
+            break;
+        case INPUT_ORGAN_PIPE: { // Rising to the middle, then falling
+            int half = (n + 1) / 2;
+            for (int k = 0; k < n; k++) out[k] = MIN_VALUE + (int)((long long)std::min(k, n - 1 - k) * range / half);
+            break;
+        }
+        case INPUT_SAWTOOTH: { // SAWTOOTH_TEETH ascending runs
+            int tooth = std::max(1, (n + SAWTOOTH_TEETH - 1) / SAWTOOTH_TEETH);
+            for (int k = 0; k < n; k++) out[k] = MIN_VALUE + (int)((long long)(k % tooth) * range / tooth);
+            break;
+        }
+        case INPUT_ZIPF: // Value MIN_VALUE + k turns up about 1/(k + 1) as often as MIN_VALUE
+            for (int& v : out) {
+                int rank = (int)std::pow((double)range + 1.0, rng.uniform()) - 1;
+                v = MIN_VALUE + std::clamp(rank, 0, range - 1);
+            }
+            break;
+        case INPUT_MEDIAN3_KILLER:
+            GenerateMedian3Killer(out, range);
+            break;
+    }
+}
+
+// --- RADIX HISTOGRAMS ---
+void HistogramDigits(const int* v, size_t n, uint32_t hist[RADIX_DIGITS][RADIX_BUCKETS]) {
+    static thread_local uint32_t copies[HISTOGRAM_COPIES][RADIX_DIGITS][RADIX_BUCKETS];
+    std::memset(copies, 0, sizeof(copies));
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i flip = _mm256_set1_epi32((int)0x80000000u), mask = _mm256_set1_epi32(RADIX_BUCKETS - 1);
+    alignas(32) uint32_t digits[RADIX_DIGITS][8];
+    for (; i + 8 <= n; i += 8) {
+        __m256i keys = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(v + i)), flip);
+        _mm256_store_si256((__m256i*)digits[0], _mm256_and_si256(keys, mask));
+        _mm256_store_si256((__m256i*)digits[1], _mm256_and_si256(_mm256_srli_epi32(keys, 8), mask));
+        _mm256_store_si256((__m256i*)digits[2], _mm256_and_si256(_mm256_srli_epi32(keys, 16), mask));
+        _mm256_store_si256((__m256i*)digits[3], _mm256_srli_epi32(keys, 24));
+        for (int lane = 0; lane < 8; lane++)
+            for (int d = 0; d < RADIX_DIGITS; d++) copies[lane % HISTOGRAM_COPIES][d][digits[d][lane]]++;
+    }
+#elif defined(__ARM_NEON)
+    const uint32x4_t flip = vdupq_n_u32(0x80000000u), mask = vdupq_n_u32(RADIX_BUCKETS - 1);
+    uint32_t digits[RADIX_DIGITS][4];
+    for (; i + 4 <= n; i += 4) {
+        uint32x4_t keys = veorq_u32(vld1q_u32((const uint32_t*)(v + i)), flip);
+        vst1q_u32(digits[0], vandq_u32(keys, mask));
+        vst1q_u32(digits[1], vandq_u32(vshrq_n_u32(keys, 8), mask));
+        vst1q_u32(digits[2], vandq_u32(vshrq_n_u32(keys, 16), mask));
+        vst1q_u32(digits[3], vshrq_n_u32(keys, 24));
+        for (int lane = 0; lane < 4; lane++)
+            for (int d = 0; d < RADIX_DIGITS; d++) copies[lane][d][digits[d][lane]]++;
+    }
+#endif
+    for (; i < n; i++)
+        for (int d = 0; d < RADIX_DIGITS; d++) copies[i % HISTOGRAM_COPIES][d][RadixDigit(v[i], d)]++;
+    for (int d = 0; d < RADIX_DIGITS; d++)
+        for (int b = 0; b < RADIX_BUCKETS; b++) {
+            uint32_t sum = 0;
+            for (int c = 0; c < HISTOGRAM_COPIES; c++) sum += copies[c][d][b];
+            hist[d][b] = sum;
+        }
+}
+
+// --- REFERENCE SORTS ---
+int benchThreads = (int)std::max(1u, std::thread::hardware_concurrency());
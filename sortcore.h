@@ -0,0 +1,3136 @@
+// The sorting core of the visualizer: the resumable steppers, the reference sorts the
+// bench measures them against, and the input distributions. Nothing in here opens a
+// window or an audio device (SDL is only used for the GPU bitonic sort's compute
+// device), so sortbench and sortcore_test build on it without the visualizer.
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <cstring>
+#include <climits>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// --- RANDOM NUMBERS ---
+// xoshiro256** (Blackman and Vigna), seeded through splitmix64: much faster than
+// std::mt19937 and far better distributed than rand().
+class Xoshiro256 {
+public:
+    explicit Xoshiro256(uint64_t seed = 0) { for (uint64_t& s : state) s = SplitMix64(seed); }
+
+    uint64_t next() {
+        uint64_t result = Rotl(state[1] * 5, 7) * 9, t = state[1] << 17;
+        state[2] ^= state[0]; state[3] ^= state[1]; state[1] ^= state[2]; state[0] ^= state[3];
+        state[2] ^= t; state[3] = Rotl(state[3], 45);
+        return result;
+    }
+    // Uniform in [0, bound) without modulo bias (Lemire's multiply-and-reject).
+    uint32_t below(uint32_t bound) {
+        uint64_t m = (next() >> 32) * bound;
+        if ((uint32_t)m < bound) {
+            uint32_t threshold = (0u - bound) % bound;
+            while ((uint32_t)m < threshold) m = (next() >> 32) * bound;
+        }
+        return (uint32_t)(m >> 32);
+    }
+    double uniform() { return (next() >> 11) * 0x1.0p-53; } // [0, 1)
+
+private:
+    uint64_t state[4];
+
+    static uint64_t Rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+    static uint64_t SplitMix64(uint64_t& x) {
+        uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+};
+
+// --- MODES ---
+enum SortMode {
+    BUBBLE_SORT, SELECTION_SORT, INSERTION_SORT, QUICK_SORT, MERGE_SORT,
+    PARALLEL_MERGE_SORT, PARALLEL_QUICK_SORT, INTRO_SORT, PDQ_SORT, TIM_SORT,
+    COUNTING_SORT, LSD_RADIX_SORT, MSD_RADIX_SORT, BITONIC_SORT, GPU_BITONIC_SORT,
+    HEAP_SORT, IN_PLACE_MERGE_SORT, SHELL_SORT_CIURA, SHELL_SORT_KNUTH, SHELL_SORT_HALVING
+};
+const int NUM_SORT_MODES = SHELL_SORT_HALVING + 1;
+inline const char* const SORT_MODE_NAMES[NUM_SORT_MODES] = {
+    "Bubble Sort", "Selection Sort", "Insertion Sort", "Quick Sort", "Merge Sort",
+    "Parallel Merge Sort", "Parallel Quick Sort", "Introsort", "Pdqsort", "TimSort",
+    "Counting Sort", "LSD Radix Sort", "MSD Radix Sort", "Bitonic Sort", "Bitonic Sort (GPU)",
+    "Heapsort", "In-Place Merge Sort", "Shell Sort (Ciura)", "Shell Sort (Knuth)", "Shell Sort (N/2^k)"
+};
+
+// --- OPERATION TRACE ---
+// A sort can be recorded once at native speed as a flat list of array operations and
+// then replayed (forwards or backwards) at any speed by the visualizer.
+enum TraceOpType : uint32_t {
+    OP_COMPARE = 0,  // arg = second index
+    OP_SWAP = 1,     // arg = second index
+    OP_WRITE = 2,    // arg = old value XOR new value, so a write undoes itself
+    OP_NETWORK = 3   // arg = size | writes << 8; brackets the writes of one sorting network
+};
+
+// 8 bytes per operation: the type lives in the top two bits of the first index.
+struct TraceOp {
+    uint32_t code;
+    int32_t arg;
+
+    TraceOpType type() const { return (TraceOpType)(code >> 30); }
+    int index() const { return (int)(code & 0x3FFFFFFFu); }
+};
+
+const size_t TRACE_CAPACITY = 1 << 24; // 128 MB of address space, touched only as it fills
+
+class OperationTrace {
+public:
+    // The buffer is allocated once and deliberately left uninitialized.
+    OperationTrace() : ops(new TraceOp[TRACE_CAPACITY]) {}
+
+    void clear() { count = 0; overflowed = false; }
+    void push(TraceOpType type, int index, int32_t arg) {
+        if (count == TRACE_CAPACITY) { overflowed = true; return; }
+        ops[count++] = {((uint32_t)type << 30) | (uint32_t)index, arg};
+    }
+    void append(const TraceOp& op) {
+        if (count == TRACE_CAPACITY) { overflowed = true; return; }
+        ops[count++] = op;
+    }
+
+    size_t size() const { return count; }
+    bool isComplete() const { return !overflowed; }
+    bool isFull() const { return overflowed; }
+    const TraceOp& operator[](size_t k) const { return ops[k]; }
+
+private:
+    std::unique_ptr<TraceOp[]> ops;
+    size_t count = 0;
+    bool overflowed = false;
+};
+
+// --- ARRAY OBSERVER ---
+// Notified after every change a stepper makes to its array, so derived views (such as
+// the aggregated bar columns) can be kept up to date without rescanning the array.
+// A swap is reported as two writes, each seeing the array with only that write applied.
+class ArrayObserver {
+public:
+    virtual ~ArrayObserver() = default;
+    virtual void onWrite(int index, int oldValue, int newValue) = 0;
+    virtual void onReset() = 0; // Any element may have changed
+    virtual void onRead(int begin, int end) {} // [begin, end) was read, e.g. by a comparison
+};
+
+// Fans the notifications out to a fixed set of observers.
+class ArrayObserverList : public ArrayObserver {
+public:
+    void add(ArrayObserver* o) { if (count < MAX_OBSERVERS) observers[count++] = o; }
+    void onWrite(int index, int oldValue, int newValue) override {
+        for (int k = 0; k < count; k++) observers[k]->onWrite(index, oldValue, newValue);
+    }
+    void onReset() override { for (int k = 0; k < count; k++) observers[k]->onReset(); }
+    void onRead(int begin, int end) override { for (int k = 0; k < count; k++) observers[k]->onRead(begin, end); }
+
+private:
+    static const int MAX_OBSERVERS = 4;
+    ArrayObserver* observers[MAX_OBSERVERS] = {};
+    int count = 0;
+};
+
+// Swaps two elements and reports it to the observer (if any) as two ordered writes.
+inline void ObservedSwap(std::vector<int>& values, int a, int b, ArrayObserver* observer) {
+    int va = values[a], vb = values[b];
+    values[a] = vb;
+    if (observer) observer->onWrite(a, va, vb);
+    values[b] = va;
+    if (observer) observer->onWrite(b, vb, va);
+}
+
+// --- SCRATCH ARENA ---
+// Steppers take their scratch space (merge buffers, range stacks) from an arena rather
+// than allocating it. The arena only grows when N does, so restarting a sort, or
+// recording one and then stepping it live, allocates nothing. No stepper needs more
+// than SCRATCH_BYTES_PER_ELEMENT per element, plus any extra it asks for up front.
+const size_t SCRATCH_BYTES_PER_ELEMENT = 8;
+const int SCRATCH_COPY_CHUNK = 64; // Elements a stepper copies into scratch per step
+
+class ScratchArena {
+public:
+    // Makes room for one stepper on n elements, releasing whatever was handed out before.
+    void reset(size_t n, size_t extraBytes = 0) {
+        size_t bytes = (n + 1) * SCRATCH_BYTES_PER_ELEMENT + extraBytes + 64;
+        if (bytes > capacity) { storage.reset(new unsigned char[bytes]); capacity = bytes; }
+        used = 0;
+    }
+
+    // Uninitialized space for `count` objects of trivial type T.
+    template <typename T>
+    T* allocate(size_t count) {
+        size_t offset = (used + alignof(T) - 1) & ~(alignof(T) - 1);
+        used = offset + count * sizeof(T);
+        return reinterpret_cast<T*>(storage.get() + offset);
+    }
+
+private:
+    std::unique_ptr<unsigned char[]> storage;
+    size_t capacity = 0, used = 0;
+};
+// --- SORTING NETWORKS ---
+// Small ranges can be finished by one branch-free bitonic sorting network for 8, 16 or
+// 32 elements instead of recursing further. The networks are generated at compile
+// time: every stage pairs each element with a partner and keeps the smaller value at
+// the lower index, which with AVX2 or NEON is one permute, min, max and blend per
+// vector of keys. Shorter ranges are padded with INT_MAX.
+const int NETWORK_MAX_SIZE = 32;
+
+constexpr int NetworkLog2(int n) { return n <= 1 ? 0 : 1 + NetworkLog2(n / 2); }
+
+template <int N>
+struct BitonicNetwork {
+    static constexpr int STAGES = NetworkLog2(N) * (NetworkLog2(N) + 1) / 2;
+    static constexpr int COMPARATORS = STAGES * N / 2;
+    int partner[STAGES][N] = {};
+
+    // Merging blocks of k, the first stage compares mirrored positions, so the block
+    // never has to be reversed; the following stages compare at halving distances.
+    constexpr BitonicNetwork() {
+        int s = 0;
+        for (int k = 2; k <= N; k *= 2)
+            for (int j = k / 2; j >= 1; j /= 2, s++)
+                for (int i = 0; i < N; i++) partner[s][i] = j == k / 2 ? i ^ (k - 1) : i ^ j;
+    }
+};
+
+// The network laid out for W-lane vectors: where each lane's partner lives, and which
+// lanes keep the maximum.
+template <int N, int W>
+struct NetworkLanes {
+    static constexpr int STAGES = BitonicNetwork<N>::STAGES, REGS = N / W;
+    alignas(32) int32_t lane[STAGES][REGS][W] = {};
+    alignas(32) int32_t takeMax[STAGES][REGS][W] = {};
+    alignas(16) uint8_t laneBytes[STAGES][REGS][W * 4] = {};  // Byte shuffle form of `lane`
+    int reg[STAGES][REGS] = {};
+
+    constexpr NetworkLanes() {
+        BitonicNetwork<N> net;
+        for (int s = 0; s < STAGES; s++)
+            for (int i = 0; i < N; i++) {
+                int p = net.partner[s][i], r = i / W, l = i % W;
+                reg[s][r] = p / W; lane[s][r][l] = p % W; takeMax[s][r][l] = i > p ? -1 : 0;
+                for (int b = 0; b < 4; b++) laneBytes[s][r][l * 4 + b] = (uint8_t)((p % W) * 4 + b);
+            }
+    }
+};
+
+template <int N> inline constexpr BitonicNetwork<N> BITONIC_NETWORK{};
+template <int N, int W> inline constexpr NetworkLanes<N, W> NETWORK_LANES{};
+
+template <int N>
+void NetworkSortBlock(int* a) {
+#if defined(__AVX2__)
+    const NetworkLanes<N, 8>& t = NETWORK_LANES<N, 8>;
+    __m256i reg[N / 8], next[N / 8];
+    for (int r = 0; r < N / 8; r++) reg[r] = _mm256_loadu_si256((const __m256i*)(a + 8 * r));
+    for (int s = 0; s < t.STAGES; s++) {
+        for (int r = 0; r < N / 8; r++) {
+            __m256i other = _mm256_permutevar8x32_epi32(reg[t.reg[s][r]], _mm256_load_si256((const __m256i*)t.lane[s][r]));
+            __m256i lo = _mm256_min_epi32(reg[r], other), hi = _mm256_max_epi32(reg[r], other);
+            next[r] = _mm256_blendv_epi8(lo, hi, _mm256_load_si256((const __m256i*)t.takeMax[s][r]));
+        }
+        for (int r = 0; r < N / 8; r++) reg[r] = next[r];
+    }
+    for (int r = 0; r < N / 8; r++) _mm256_storeu_si256((__m256i*)(a + 8 * r), reg[r]);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const NetworkLanes<N, 4>& t = NETWORK_LANES<N, 4>;
+    int32x4_t reg[N / 4], next[N / 4];
+    for (int r = 0; r < N / 4; r++) reg[r] = vld1q_s32(a + 4 * r);
+    for (int s = 0; s < t.STAGES; s++) {
+        for (int r = 0; r < N / 4; r++) {
+            int32x4_t other = vreinterpretq_s32_u8(vqtbl1q_u8(vreinterpretq_u8_s32(reg[t.reg[s][r]]), vld1q_u8(t.laneBytes[s][r])));
+            int32x4_t lo = vminq_s32(reg[r], other), hi = vmaxq_s32(reg[r], other);
+            next[r] = vbslq_s32(vreinterpretq_u32_s32(vld1q_s32(t.takeMax[s][r])), hi, lo);
+        }
+        for (int r = 0; r < N / 4; r++) reg[r] = next[r];
+    }
+    for (int r = 0; r < N / 4; r++) vst1q_s32(a + 4 * r, reg[r]);
+#else
+    const BitonicNetwork<N>& net = BITONIC_NETWORK<N>;
+    for (int s = 0; s < net.STAGES; s++) {
+        int next[N];
+        for (int i = 0; i < N; i++) {
+            int p = net.partner[s][i];
+            next[i] = i < p ? std::min(a[i], a[p]) : std::max(a[i], a[p]);
+        }
+        std::copy(next, next + N, a);
+    }
+#endif
+}
+
+// The comparators the network that sorts `size` elements is made of.
+inline int NetworkComparators(int size) {
+    return size <= 8 ? BitonicNetwork<8>::COMPARATORS : size <= 16 ? BitonicNetwork<16>::COMPARATORS : BitonicNetwork<32>::COMPARATORS;
+}
+
+// Sorts a[0, size) for size <= NETWORK_MAX_SIZE with the smallest network that fits.
+inline void NetworkSort(int* a, int size) {
+    alignas(32) int block[NETWORK_MAX_SIZE];
+    int width = size <= 8 ? 8 : size <= 16 ? 16 : 32;
+    std::copy(a, a + size, block);
+    std::fill(block + size, block + width, INT_MAX);
+    if (width == 8) NetworkSortBlock<8>(block);
+    else if (width == 16) NetworkSortBlock<16>(block);
+    else NetworkSortBlock<32>(block);
+    std::copy(block, block + size, a);
+}
+
+// Network leaves are optional (N in the visualizer, --network in the bench). Steppers
+// are told through CreateStepper; the bench's reference sorts read this directly.
+extern bool networkLeaves;
+// --- SORT STEPPERS ---
+// Each algorithm is a resumable state machine: step() advances it by one comparison
+// or swap, so the visualizer can pace it and the bench can run it headless.
+enum HighlightKind : int {
+    HIGHLIGHT_ACTIVE,   // Element being compared or moved (red)
+    HIGHLIGHT_MARKER,   // Pivot / current minimum (magenta)
+    HIGHLIGHT_WRITE,    // Element just written (white)
+    HIGHLIGHT_NETWORK,  // Range a sorting network is about to sort (cyan)
+    HIGHLIGHT_LANE_0    // Range owned by a parallel lane, one colour per lane from here on
+};
+
+// A single element, or the range [index, end) when end > index. Ranges are drawn
+// first, so element highlights inside them stay visible.
+struct Highlight {
+    int index;
+    HighlightKind kind;
+    int end = 0;
+};
+
+const int PARALLEL_LANES = 4;  // Lanes the parallel steppers simulate
+const int MAX_HIGHLIGHTS = 2 * PARALLEL_LANES;
+
+class SortStepper {
+public:
+    explicit SortStepper(std::vector<int>& values) : values(values) {}
+    virtual ~SortStepper() = default;
+
+    virtual void step() = 0;
+    bool isDone() const { return done; }
+
+    // Writes up to MAX_HIGHLIGHTS entries into out and returns how many were written.
+    virtual int highlights(Highlight* out) const = 0;
+    // Completed fraction in [0, 1]. Not necessarily monotonic; the progress bar clamps it.
+    virtual float progress() const = 0;
+    // [begin, end) holds elements already in their final place (drawn white).
+    virtual void sortedRange(int& begin, int& end) const { begin = end = 0; }
+    // Steppers that write outside `values` mid-pass describe what the array logically
+    // holds: front[k] for k < split and back[k] from there on. Returns false when
+    // `values` itself is up to date.
+    virtual bool view(const int*& front, const int*& back, int& split) const { return false; }
+    // False when the work happens where no trace can see it (on the GPU), so the worker
+    // steps it live instead of recording it.
+    virtual bool recordable() const { return true; }
+
+    unsigned long long comparisons = 0;
+    unsigned long long swaps = 0;
+    // Software model of the memory traffic: the bytes of the elements this run read and
+    // wrote (see noteTraffic). Replays don't track it.
+    unsigned long long bytesRead = 0, bytesWritten = 0;
+    // Peak auxiliary memory: the most bytes the algorithm needed besides `values` at any
+    // one time (scratch buffers, pending-range stacks, count tables; see noteAux).
+    // Stacks count their high-water mark, not the worst case the arena reserves.
+    size_t peakAuxBytes = 0;
+    int soundValue = 0; // Height of the last bar touched
+    OperationTrace* trace = nullptr; // When set, every array operation is recorded
+    ArrayObserver* observer = nullptr;
+
+protected:
+    std::vector<int>& values;
+    bool done = false;
+    int n() const { return (int)values.size(); }
+
+    // All array access goes through these so counters and the trace stay exact. A
+    // comparison reads two elements, a swap reads and writes two, and a write moves one
+    // (one read, one write). Passes that read or copy elements without comparing them
+    // (histograms, copies into scratch) call noteRead themselves. The observer sees
+    // the compared and noteRead elements as reads.
+    void noteTraffic(int reads, int writes) { bytesRead += reads * sizeof(int); bytesWritten += writes * sizeof(int); }
+    void noteAux(size_t bytes) { peakAuxBytes = std::max(peakAuxBytes, bytes); }
+    // Pushes onto a pending-work stack and accounts for its new depth.
+    template <typename Entry>
+    void pushTask(Entry* stack, int& depth, const Entry& entry) { stack[depth++] = entry; noteAux(depth * sizeof(Entry)); }
+    void noteRead(int begin, int end) { noteTraffic(end - begin, 0); if (observer) observer->onRead(begin, end); }
+    void noteCompare(int a, int b) {
+        comparisons++; noteTraffic(2, 0); if (trace) trace->push(OP_COMPARE, a, b);
+        if (observer) { observer->onRead(a, a + 1); observer->onRead(b, b + 1); }
+    }
+    bool less(int a, int b) { noteCompare(a, b); return values[a] < values[b]; }
+    void swapAt(int a, int b) {
+        swaps++; noteTraffic(2, 2); if (trace) trace->push(OP_SWAP, a, b);
+        ObservedSwap(values, a, b, observer);
+    }
+    void write(int k, int v) {
+        swaps++; noteTraffic(1, 1); if (trace) trace->push(OP_WRITE, k, values[k] ^ v);
+        int old = values[k];
+        values[k] = v;
+        if (observer) observer->onWrite(k, old, v);
+    }
+    // Sorts [lo, lo + size) with one sorting network. It counts all of the network's
+    // comparators, writes only the elements that moved, and is traced as a single
+    // operation.
+    void networkSort(int lo, int size) {
+        if (size < 2) return;
+        int sorted[NETWORK_MAX_SIZE];
+        std::copy(values.begin() + lo, values.begin() + lo + size, sorted);
+        noteRead(lo, lo + size); noteAux(size * sizeof(int));
+        NetworkSort(sorted, size);
+        int writes = 0;
+        for (int k = 0; k < size; k++) writes += sorted[k] != values[lo + k];
+        comparisons += NetworkComparators(size);
+        if (trace) trace->push(OP_NETWORK, lo, size | writes << 8);
+        for (int k = 0; k < size; k++) if (sorted[k] != values[lo + k]) write(lo + k, sorted[k]);
+        if (trace) trace->push(OP_NETWORK, lo, size | writes << 8);
+        soundValue = values[lo + size - 1];
+    }
+};
+
+class BubbleSortStepper : public SortStepper {
+public:
+    using SortStepper::SortStepper;
+
+    void step() override {
+        if (n() < 2) { done = true; return; }
+        soundValue = values[j+1];
+        if (less(j+1, j)) swapAt(j, j+1);
+        j++; if (j >= n() - 1 - i) { j = 0; i++; if (i >= n() - 1) done = true; }
+    }
+    int highlights(Highlight* out) const override {
+        out[0] = {j, HIGHLIGHT_ACTIVE}; out[1] = {j + 1, HIGHLIGHT_ACTIVE};
+        return 2;
+    }
+    float progress() const override { return (float)i / n(); }
+    void sortedRange(int& begin, int& end) const override { begin = n() - i; end = n(); }
+
+private:
+    int i = 0, j = 0;
+};
+
+class SelectionSortStepper : public SortStepper {
+public:
+    using SortStepper::SortStepper;
+
+    void step() override {
+        if (n() < 2) { done = true; return; }
+        soundValue = values[j];
+        if (less(j, minIdx)) minIdx = j;
+        j++; if (j >= n()) { swapAt(i, minIdx); i++; j = i + 1; minIdx = i; if (i >= n() - 1) done = true; }
+    }
+    int highlights(Highlight* out) const override {
+        out[0] = {j, HIGHLIGHT_ACTIVE}; out[1] = {minIdx, HIGHLIGHT_MARKER};
+        return 2;
+    }
+    float progress() const override { return (float)i / n(); }
+    void sortedRange(int& begin, int& end) const override { begin = 0; end = i; }
+
+private:
+    int i = 0, j = 1, minIdx = 0;
+};
+
+class InsertionSortStepper : public SortStepper {
+public:
+    using SortStepper::SortStepper;
+
+    void step() override {
+        if (i >= n()) { done = true; return; }
+        soundValue = values[j];
+        if (j > 0 && less(j, j-1)) { swapAt(j, j-1); j--; }
+        else { i++; j = i; if (i >= n()) done = true; }
+    }
+    int highlights(Highlight* out) const override {
+        out[0] = {j, HIGHLIGHT_ACTIVE};
+        return 1;
+    }
+    float progress() const override { return (float)i / n(); }
+
+private:
+    int i = 1, j = 1;
+};
+
+class QuickSortStepper : public SortStepper {
+public:
+    // Pending ranges are disjoint and hold at least two elements, so n/2 + 1 slots suffice.
+    // With network leaves, a popped range that fits a sorting network is finished by
+    // one network step instead of being partitioned.
+    QuickSortStepper(std::vector<int>& values, ScratchArena& arena, bool networkLeaves = false)
+        : SortStepper(values), stack(arena.allocate<std::pair<int, int>>(values.size() / 2 + 1)), networkLeaves(networkLeaves) {
+        if (n() > 1) pushTask(stack, depth, {0, n() - 1});
+    }
+
+    void step() override {
+        if (networkPending) {
+            networkSort(l, r - l + 1); placed += r - l + 1; networkPending = false;
+        } else if (!partitionMode) {
+            if (depth == 0) { done = true; } else { auto range = stack[--depth]; l = range.first; r = range.second; i = l - 1; j = l;
+                if (networkLeaves && r - l + 1 <= NETWORK_MAX_SIZE) networkPending = true; else partitionMode = true; }
+        } else {
+            soundValue = values[j];
+            if (j < r) { if (less(j, r)) { i++; swapAt(i, j); } j++; } else { swapAt(i + 1, r); int p = i + 1; placed++; if (p + 1 < r) pushTask(stack, depth, {p + 1, r}); else if (p + 1 == r) placed++; if (l < p - 1) pushTask(stack, depth, {l, p - 1}); else if (l == p - 1) placed++; partitionMode = false; }
+        }
+    }
+    int highlights(Highlight* out) const override {
+        if (networkPending) { out[0] = {l, HIGHLIGHT_NETWORK, r + 1}; return 1; }
+        out[0] = {j, HIGHLIGHT_ACTIVE}; out[1] = {r, HIGHLIGHT_MARKER};
+        return 2;
+    }
+    // Elements known to be in their final place: pivots, single-element ranges and
+    // network-sorted ranges.
+    float progress() const override { return (float)placed / n(); }
+
+private:
+    std::pair<int, int>* stack;
+    int depth = 0;
+    int l = 0, r = 0, i = 0, j = 0;
+    int placed = 0;
+    bool partitionMode = false, networkLeaves, networkPending = false;
+};
+
+// Bottom-up merge sort that ping-pongs between the array and one scratch buffer: each
+// pass merges runs from one into the other, so nothing is ever bulk-copied. When the
+// number of passes is odd, the first pass sorts pairs in place instead, so the last
+// pass still lands in the array. With network leaves that first pass always runs and
+// sorts blocks of 32 (or 16, to keep the merge pass count even) with one network
+// each. Every write is reported against the logical array (the destination up to the
+// write position, the source after it).
+class MergeSortStepper : public SortStepper {
+public:
+    MergeSortStepper(std::vector<int>& values, ScratchArena& arena, bool networkLeaves = false)
+        : SortStepper(values), scratch(arena.allocate<int>(values.size())), networkLeaves(networkLeaves) {
+        if (networkLeaves && n() > 1) {
+            int merges = 0;
+            while ((NETWORK_MAX_SIZE << merges) < n()) merges++;
+            leafWidth = merges % 2 == 0 ? NETWORK_MAX_SIZE : NETWORK_MAX_SIZE / 2;
+            totalPasses = merges + (leafWidth < NETWORK_MAX_SIZE) + 1;
+            leafPass = true;
+        } else {
+            while ((1 << totalPasses) < n()) totalPasses++;
+            leafPass = totalPasses % 2 == 1;
+        }
+        src = values.data(); dst = scratch;
+        if (n() > 1) noteAux(n() * sizeof(int));
+    }
+
+    void step() override {
+        if (pass >= totalPasses) { done = true; return; }
+        if (leafPass) {
+            if (networkLeaves && leftStart < n()) { networkSort(leftStart, std::min(leafWidth, n() - leftStart)); leftStart += leafWidth; }
+            else if (!networkLeaves && leftStart + 1 < n()) { soundValue = values[leftStart]; if (less(leftStart + 1, leftStart)) swapAt(leftStart, leftStart + 1); leftStart += 2; }
+            else { leafPass = false; leftStart = 0; width = leafWidth; pass++; }
+            return;
+        }
+        if (!merging) {
+            if (leftStart >= n()) { std::swap(src, dst); width *= 2; leftStart = 0; pass++; return; }
+            l = leftStart; m = std::min(leftStart + width - 1, n() - 1); r = std::min(leftStart + 2 * width - 1, n() - 1); i = l; j = m + 1; k = l; merging = true;
+        }
+        bool takeLeft;
+        if (i > m) takeLeft = false;
+        else if (j > r) takeLeft = true;
+        else { noteCompare(i, j); takeLeft = src[i] <= src[j]; }
+        emit(k++, takeLeft ? src[i++] : src[j++]);
+        if (k > r) { merging = false; leftStart += 2 * width; }
+    }
+    int highlights(Highlight* out) const override {
+        if (leafPass && networkLeaves && leftStart < n()) { out[0] = {leftStart, HIGHLIGHT_NETWORK, std::min(leftStart + leafWidth, n())}; return 1; }
+        if (!merging) return 0;
+        out[0] = {k - 1, HIGHLIGHT_WRITE};
+        return 1;
+    }
+    // Completed passes plus the position within the current one.
+    float progress() const override {
+        return totalPasses ? (pass + (float)std::min(leftStart, n()) / n()) / totalPasses : 1.0f;
+    }
+    bool view(const int*& front, const int*& back, int& split) const override {
+        if (done || leafPass) return false;
+        front = dst; back = src;
+        split = merging ? k : std::min(leftStart, n());
+        return true;
+    }
+
+private:
+    int* scratch;
+    int* src;  // Runs of the previous pass
+    int* dst;  // Where this pass merges them to
+    int width = 1, leftStart = 0, l = 0, m = 0, r = 0, i = 0, j = 0, k = 0;
+    int pass = 0, totalPasses = 0, leafWidth = 2;
+    bool merging = false, leafPass = false, networkLeaves;
+
+    // Like write(), but into dst; the logical value being replaced is still in src.
+    void emit(int at, int v) {
+        int old = src[at];
+        swaps++; noteTraffic(1, 1); if (trace) trace->push(OP_WRITE, at, old ^ v);
+        dst[at] = v; soundValue = v;
+        if (observer) observer->onWrite(at, old, v);
+    }
+};
+
+// The parallel steppers simulate PARALLEL_LANES workers. Each step() advances every
+// busy lane by one operation, so the array changes the way it would with that many
+// threads sharing it, and each lane's range is highlighted in its own colour. The
+// real multi-threaded versions (see the benchmark) report the actual speedup.
+
+// Bottom-up merge sort whose lanes share out the independent blocks of a pass.
+// All lanes wait at the end of a pass, just like threads at a barrier. A lane merges
+// straight into the array: the right run is never overwritten before it is read (the
+// write position stays behind it), so only left run elements are moved into `temp`,
+// one at a time, just before the merge writes over their slot. No step copies more
+// than one element, and `values` always holds the logical array. The first pass is
+// MergeSortStepper's (pairs in place, or network-sorted blocks), with the lanes taking
+// one pair or block each, so its counts match the ping-pong reference.
+class ParallelMergeSortStepper : public SortStepper {
+public:
+    ParallelMergeSortStepper(std::vector<int>& values, ScratchArena& arena, bool networkLeaves = false)
+        : SortStepper(values), temp(arena.allocate<int>(values.size())), networkLeaves(networkLeaves) {
+        if (networkLeaves && n() > 1) {
+            int merges = 0;
+            while ((NETWORK_MAX_SIZE << merges) < n()) merges++;
+            leafWidth = merges % 2 == 0 ? NETWORK_MAX_SIZE : NETWORK_MAX_SIZE / 2;
+            totalPasses = merges + (leafWidth < NETWORK_MAX_SIZE) + 1;
+            leafPass = true;
+        } else {
+            while ((1 << totalPasses) < n()) totalPasses++;
+            leafPass = totalPasses % 2 == 1;
+        }
+        if (n() > 1) noteAux(n() * sizeof(int));
+    }
+
+    void step() override {
+        if (leafPass) { leafStep(); return; }
+        if (width >= n()) { done = true; return; }
+        bool busy = false;
+        for (Lane& lane : lanes) {
+            if (!lane.active) {
+                if (nextLeft >= n() - 1) continue;
+                lane.l = nextLeft; lane.m = std::min(nextLeft + width - 1, n() - 1); lane.r = std::min(nextLeft + 2 * width - 1, n() - 1);
+                lane.i = lane.l; lane.j = lane.m + 1; lane.k = lane.l;
+                nextLeft += 2 * width; lane.active = true;
+            } else if (lane.k <= lane.r) {
+                bool takeLeft;
+                if (lane.i > lane.m) takeLeft = false;
+                else if (lane.j > lane.r) takeLeft = true;
+                else { noteCompare(lane.i, lane.j); takeLeft = left(lane) <= values[lane.j]; }
+                int v = takeLeft ? left(lane) : values[lane.j];
+                if (takeLeft) lane.i++; else lane.j++;
+                // The left run element about to be overwritten moves aside first
+                if (lane.k <= lane.m) { temp[lane.k] = values[lane.k]; noteRead(lane.k, lane.k + 1); noteTraffic(0, 1); }
+                write(lane.k++, v); soundValue = v;
+            } else {
+                lane.active = false;
+            }
+            busy = true;
+        }
+        if (!busy) { width *= 2; nextLeft = 0; pass++; }
+    }
+    int highlights(Highlight* out) const override {
+        int count = 0;
+        for (int t = 0; t < PARALLEL_LANES; t++)
+            if (lanes[t].active) out[count++] = {lanes[t].l, (HighlightKind)(HIGHLIGHT_LANE_0 + t), lanes[t].r + 1};
+        for (const Lane& lane : lanes)
+            if (lane.active && lane.k > lane.l) out[count++] = {lane.k - 1, HIGHLIGHT_WRITE};
+        return count;
+    }
+    float progress() const override {
+        return totalPasses ? (pass + (float)std::min(nextLeft, n()) / n()) / totalPasses : 1.0f;
+    }
+
+private:
+    struct Lane { int l = 0, m = 0, r = 0, i = 0, j = 0, k = 0; bool active = false; };
+    int* temp;  // Left run elements whose slot has already been written
+    Lane lanes[PARALLEL_LANES];
+    int width = 1, nextLeft = 0, pass = 0, totalPasses = 0, leafWidth = 2;
+    bool leafPass = false, networkLeaves;
+
+    // Each lane sorts the next pair or network block; the pass ends once none is left.
+    void leafStep() {
+        bool busy = false;
+        for (Lane& lane : lanes) {
+            lane.active = false;
+            if (networkLeaves ? nextLeft >= n() : nextLeft + 1 >= n()) continue;
+            int size = std::min(leafWidth, n() - nextLeft);
+            lane.l = lane.k = nextLeft; lane.r = nextLeft + size - 1; lane.active = true;
+            if (networkLeaves) networkSort(nextLeft, size);
+            else { soundValue = values[nextLeft]; if (less(nextLeft + 1, nextLeft)) swapAt(nextLeft, nextLeft + 1); }
+            nextLeft += size; busy = true;
+        }
+        if (!busy) { leafPass = false; width = leafWidth; nextLeft = 0; pass++; }
+    }
+
+    // The next left run element: moved aside once the merge has written over its slot.
+    int left(const Lane& lane) const { return lane.i < lane.k ? temp[lane.i] : values[lane.i]; }
+};
+
+// Lomuto quicksort whose lanes each keep a deque of pending ranges. A lane takes its
+// newest range and, when it has none, steals the oldest range of the busiest lane.
+class ParallelQuickSortStepper : public SortStepper {
+public:
+    explicit ParallelQuickSortStepper(std::vector<int>& values) : SortStepper(values) {
+        if (n() > 1) lanes[0].ranges.push_back({0, n() - 1});
+        else placed = n();
+    }
+
+    void step() override {
+        bool busy = false;
+        for (int t = 0; t < PARALLEL_LANES; t++) {
+            Lane& lane = lanes[t];
+            if (!lane.partitioning) {
+                std::deque<std::pair<int, int>>* source = &lane.ranges;
+                if (source->empty()) {
+                    for (Lane& other : lanes) if (other.ranges.size() > source->size()) source = &other.ranges;
+                    if (source->empty()) continue;
+                    lane.range = source->front(); source->pop_front();
+                } else {
+                    lane.range = source->back(); source->pop_back();
+                }
+                lane.i = lane.range.first - 1; lane.j = lane.range.first; lane.partitioning = true;
+            } else {
+                auto [l, r] = lane.range;
+                soundValue = values[lane.j];
+                if (lane.j < r) { if (less(lane.j, r)) { lane.i++; swapAt(lane.i, lane.j); } lane.j++; }
+                else {
+                    swapAt(lane.i + 1, r); int p = lane.i + 1; placed++;
+                    if (p + 1 < r) lane.ranges.push_back({p + 1, r}); else if (p + 1 == r) placed++;
+                    if (l < p - 1) lane.ranges.push_back({l, p - 1}); else if (l == p - 1) placed++;
+                    lane.partitioning = false;
+                    noteAux(pendingRanges() * sizeof(std::pair<int, int>));
+                }
+            }
+            busy = true;
+        }
+        if (!busy) done = true;
+    }
+    int highlights(Highlight* out) const override {
+        int count = 0;
+        for (int t = 0; t < PARALLEL_LANES; t++)
+            if (lanes[t].partitioning) out[count++] = {lanes[t].range.first, (HighlightKind)(HIGHLIGHT_LANE_0 + t), lanes[t].range.second + 1};
+        for (const Lane& lane : lanes)
+            if (lane.partitioning) out[count++] = {lane.j, HIGHLIGHT_ACTIVE};
+        return count;
+    }
+    float progress() const override { return n() ? (float)placed / n() : 1.0f; }
+
+private:
+    struct Lane {
+        std::deque<std::pair<int, int>> ranges;
+        std::pair<int, int> range{0, 0};
+        int i = 0, j = 0;
+        bool partitioning = false;
+    };
+    Lane lanes[PARALLEL_LANES];
+    int placed = 0;
+
+    size_t pendingRanges() const {
+        size_t total = 0;
+        for (const Lane& lane : lanes) total += lane.ranges.size();
+        return total;
+    }
+};
+
+// --- HYBRID SORTS ---
+// Introsort, pdqsort and TimSort, the kind of hybrids production libraries ship. Each
+// step() still performs at most one comparison, so their cutoffs and fallbacks can be
+// watched and counted like the textbook sorts.
+const int INTRO_INSERTION_CUTOFF = 16;   // Ranges this small are insertion sorted
+const int PDQ_INSERTION_CUTOFF = 24;
+const int PDQ_NINTHER_THRESHOLD = 128;   // Larger ranges pick the pivot as a median of medians
+const int PDQ_PARTIAL_INSERTION_LIMIT = 8;
+const int TIM_MIN_MERGE = 64;            // Arrays shorter than this become a single run
+const int TIM_MIN_GALLOP = 7;
+const int TIM_MAX_PENDING_RUNS = 85;     // Enough for any array under 2^64 elements
+
+inline int FloorLog2(int n) { int log = 0; while (n > 1) { n >>= 1; log++; } return log; }
+
+// Building blocks shared by the hybrid sorts. Each is started with begin*() and
+// then advanced by its step*() function, which returns true once it has finished.
+class HybridSortStepper : public SortStepper {
+public:
+    HybridSortStepper(std::vector<int>& values, bool networkLeaves = false) : SortStepper(values), networkLeaves(networkLeaves) {}
+
+protected:
+    bool networkLeaves;  // Small ranges get one sorting network step instead of insertion sort
+
+    // Compare-and-swaps and plain swaps queued up (pivot selection, pattern breaking)
+    enum QueuedKind { QUEUED_SORT2, QUEUED_SWAP };
+    struct QueuedOp { int a, b; QueuedKind kind; };
+    QueuedOp queue[16];
+    int queued = 0, queuePos = 0;
+
+    void queueSort2(int a, int b) { queue[queued++] = {a, b, QUEUED_SORT2}; }
+    void queueSort3(int a, int b, int c) { queueSort2(a, b); queueSort2(b, c); queueSort2(a, b); }
+    void queueSwap(int a, int b) { queue[queued++] = {a, b, QUEUED_SWAP}; }
+    // Runs the next queued operation, or returns true (doing nothing) once all have run.
+    bool stepQueue() {
+        if (queuePos == queued) { queued = queuePos = 0; return true; }
+        const QueuedOp& op = queue[queuePos++];
+        soundValue = values[op.a];
+        if (op.kind == QUEUED_SWAP || less(op.b, op.a)) swapAt(op.a, op.b);
+        return false;
+    }
+
+    // Insertion sort of [insBegin, insEnd). With a move limit it gives up (insFailed)
+    // once an element's insertion pushes the total moves past the limit.
+    int insBegin = 0, insEnd = 0, insI = 0, insJ = 0, insMoves = 0, insLimit = -1;
+    bool insFailed = false;
+
+    void beginInsertion(int begin, int end, int moveLimit = -1) {
+        insBegin = begin; insEnd = end; insI = insJ = begin + 1; insMoves = 0; insLimit = moveLimit; insFailed = false;
+    }
+    bool stepInsertion() {
+        if (insI >= insEnd) return true;
+        soundValue = values[insJ];
+        if (insJ > insBegin && less(insJ, insJ - 1)) { swapAt(insJ, insJ - 1); insJ--; insMoves++; return false; }
+        if (insLimit >= 0 && insMoves > insLimit) { insFailed = true; return true; }
+        insI++; insJ = insI;
+        return insI >= insEnd;
+    }
+
+    // Heapsort of [heapBegin, heapBegin + heapCount): build a max-heap, then repeatedly
+    // swap the root behind the shrinking heap. A sift costs up to two steps per level.
+    int heapBegin = 0, heapCount = 0, heapStart = 0, heapEnd = 0, siftRoot = 0, siftChild = -1;
+    bool heapBuilding = false;
+
+    void beginHeap(int begin, int end) {
+        heapBegin = begin; heapCount = end - begin; heapEnd = heapCount;
+        heapStart = heapCount / 2 - 1; heapBuilding = true;
+        siftRoot = std::max(heapStart, 0); siftChild = -1;
+    }
+    bool stepHeap() {
+        if (heapCount < 2) return true;
+        if (siftChild < 0) {
+            int child = 2 * siftRoot + 1;
+            if (child < heapEnd) {
+                siftChild = child;
+                if (child + 1 < heapEnd) { soundValue = values[heapBegin + child]; if (less(heapBegin + child, heapBegin + child + 1)) siftChild++; return false; }
+            }
+        }
+        if (siftChild >= 0) {
+            soundValue = values[heapBegin + siftChild];
+            bool sink = less(heapBegin + siftRoot, heapBegin + siftChild);
+            if (sink) { swapAt(heapBegin + siftRoot, heapBegin + siftChild); siftRoot = siftChild; }
+            siftChild = -1;
+            if (sink) return false;
+        }
+        // The sift is over: start the next one
+        if (heapBuilding && --heapStart >= 0) { siftRoot = heapStart; return false; }
+        heapBuilding = false;
+        if (--heapEnd < 1) return true;
+        swapAt(heapBegin, heapBegin + heapEnd);
+        siftRoot = 0;
+        return heapEnd < 2;
+    }
+    int heapHighlights(Highlight* out) const {
+        if (siftChild < 0) { out[0] = {heapBegin + siftRoot, HIGHLIGHT_MARKER}; return 1; }
+        out[0] = {heapBegin + siftRoot, HIGHLIGHT_MARKER}; out[1] = {heapBegin + siftChild, HIGHLIGHT_ACTIVE};
+        return 2;
+    }
+};
+
+// Quicksort with a median-of-three pivot that falls back to heapsort once the
+// recursion depth passes 2 log2 N, and insertion sorts small ranges.
+class IntroSortStepper : public HybridSortStepper {
+public:
+    IntroSortStepper(std::vector<int>& values, ScratchArena& arena, bool networkLeaves = false)
+        : HybridSortStepper(values, networkLeaves), stack(arena.allocate<Task>(values.size() / 2 + 1)) {
+        if (n() > 1) pushTask(stack, depth, {0, n() - 1, 2 * FloorLog2(n())});
+        else placed = n();
+    }
+
+    void step() override {
+        switch (phase) {
+            case NEXT: {
+                if (depth == 0) { done = true; return; }
+                task = stack[--depth];
+                int size = task.hi - task.lo + 1;
+                if (size <= INTRO_INSERTION_CUTOFF && networkLeaves) { phase = NETWORK; return; }
+                if (size <= INTRO_INSERTION_CUTOFF) { beginInsertion(task.lo, task.hi + 1); phase = INSERTION; }
+                else if (task.depth == 0) { beginHeap(task.lo, task.hi + 1); phase = HEAP; }
+                else { int mid = task.lo + size / 2; queueSort3(task.lo, mid, task.hi); queueSwap(mid, task.hi); phase = PIVOT; }
+                step();
+                return;
+            }
+            case PIVOT:
+                if (stepQueue()) { i = task.lo - 1; j = task.lo; phase = PARTITION; step(); }
+                return;
+            case PARTITION: {
+                int l = task.lo, r = task.hi;
+                soundValue = values[j];
+                if (j < r) { if (less(j, r)) { i++; swapAt(i, j); } j++; return; }
+                swapAt(i + 1, r); int p = i + 1; placed++;
+                if (p + 1 < r) pushTask(stack, depth, {p + 1, r, task.depth - 1}); else if (p + 1 == r) placed++;
+                if (l < p - 1) pushTask(stack, depth, {l, p - 1, task.depth - 1}); else if (l == p - 1) placed++;
+                phase = NEXT;
+                return;
+            }
+            case INSERTION:
+                if (stepInsertion()) { placed += task.hi - task.lo + 1; phase = NEXT; }
+                return;
+            case NETWORK:
+                networkSort(task.lo, task.hi - task.lo + 1); placed += task.hi - task.lo + 1; phase = NEXT;
+                return;
+            case HEAP:
+                if (stepHeap()) { placed += task.hi - task.lo + 1; phase = NEXT; }
+                return;
+        }
+    }
+    int highlights(Highlight* out) const override {
+        if (done || phase == NEXT) return 0;
+        if (phase == NETWORK) { out[0] = {task.lo, HIGHLIGHT_NETWORK, task.hi + 1}; return 1; }
+        out[0] = {task.lo, phase == HEAP ? (HighlightKind)(HIGHLIGHT_LANE_0 + 1) : HIGHLIGHT_LANE_0, task.hi + 1};
+        switch (phase) {
+            case PARTITION: out[1] = {j, HIGHLIGHT_ACTIVE}; out[2] = {task.hi, HIGHLIGHT_MARKER}; return 3;
+            case INSERTION: out[1] = {insJ, HIGHLIGHT_ACTIVE}; return 2;
+            case HEAP: return 1 + heapHighlights(out + 1);
+            default: return 1;
+        }
+    }
+    float progress() const override { return n() ? (float)placed / n() : 1.0f; }
+
+private:
+    struct Task { int lo, hi, depth; };
+    enum Phase { NEXT, PIVOT, PARTITION, INSERTION, NETWORK, HEAP };
+    Task* stack;
+    int depth = 0;
+    Task task{0, 0, 0};
+    Phase phase = NEXT;
+    int i = 0, j = 0, placed = 0;
+};
+
+// Pattern-defeating quicksort (after Orson Peters' pdqsort): ninther pivots, a
+// partition that notices already partitioned input and then tries a bounded insertion
+// sort, equal-element partitioning for runs of duplicates, and shuffles plus a
+// heapsort fallback against adversarial patterns.
+class PdqSortStepper : public HybridSortStepper {
+public:
+    PdqSortStepper(std::vector<int>& values, ScratchArena& arena, bool networkLeaves = false)
+        : HybridSortStepper(values, networkLeaves), stack(arena.allocate<Frame>(values.size() / 2 + 1)) {
+        if (n() > 1) pushTask(stack, depth, {0, n(), FloorLog2(n()), true});
+        else placed = n();
+    }
+
+    void step() override {
+        switch (phase) {
+            case NEXT:
+                if (depth == 0) { done = true; return; }
+                frame = stack[--depth];
+                startFrame();
+                if (phase != NETWORK) step();
+                return;
+            case PIVOT:
+                if (!stepQueue()) return;
+                if (!frame.leftmost) {
+                    soundValue = values[frame.begin];
+                    if (!less(frame.begin - 1, frame.begin)) { first = frame.begin; last = frame.end; phase = LEFT_SCAN_LAST; return; }
+                }
+                first = frame.begin; last = frame.end; phase = RIGHT_SCAN_FIRST;
+                if (frame.leftmost) step();
+                return;
+
+            // Elements smaller than the pivot (at begin) go left, the rest right
+            case RIGHT_SCAN_FIRST:
+                soundValue = values[first + 1];
+                if (less(++first, frame.begin)) return;
+                guarded = first - 1 == frame.begin;
+                phase = RIGHT_SCAN_LAST;
+                return;
+            case RIGHT_SCAN_LAST:
+                if (guarded && first >= last) { finishRightScan(); step(); return; }
+                soundValue = values[last - 1];
+                if (!less(--last, frame.begin)) return;
+                finishRightScan();
+                return;
+            case RIGHT_SWAP:
+                if (first >= last) { rightDone(); return; }
+                swapAt(first, last); phase = RIGHT_LOOP_FIRST;
+                return;
+            case RIGHT_LOOP_FIRST:
+                soundValue = values[first + 1];
+                if (!less(++first, frame.begin)) phase = RIGHT_LOOP_LAST;
+                return;
+            case RIGHT_LOOP_LAST:
+                soundValue = values[last - 1];
+                if (!less(--last, frame.begin)) return;
+                phase = RIGHT_SWAP;
+                if (first >= last) { rightDone(); }
+                return;
+
+            // The pivot equals the element before the range: sweep everything equal to it left
+            case LEFT_SCAN_LAST:
+                soundValue = values[last - 1];
+                if (less(frame.begin, --last)) return;
+                guarded = last + 1 == frame.end;
+                phase = LEFT_SCAN_FIRST;
+                return;
+            case LEFT_SCAN_FIRST:
+                if (guarded && first >= last) { leftDone(); return; }
+                soundValue = values[first + 1];
+                if (!less(frame.begin, ++first)) return;
+                phase = LEFT_SWAP;
+                return;
+            case LEFT_SWAP:
+                if (first >= last) { leftDone(); return; }
+                swapAt(first, last); phase = LEFT_LOOP_LAST;
+                return;
+            case LEFT_LOOP_LAST:
+                soundValue = values[last - 1];
+                if (!less(frame.begin, --last)) phase = LEFT_LOOP_FIRST;
+                return;
+            case LEFT_LOOP_FIRST:
+                soundValue = values[first + 1];
+                if (!less(frame.begin, ++first)) return;
+                phase = LEFT_SWAP;
+                return;
+
+            case BREAK_PATTERNS:
+                if (stepQueue()) { split(); step(); }
+                return;
+            case PARTIAL_LEFT:
+                if (!stepInsertion()) return;
+                if (insFailed) { split(); return; }
+                beginInsertion(pivot + 1, frame.end, PDQ_PARTIAL_INSERTION_LIMIT); phase = PARTIAL_RIGHT;
+                return;
+            case PARTIAL_RIGHT:
+                if (!stepInsertion()) return;
+                if (insFailed) { split(); return; }
+                placed += frame.end - frame.begin; phase = NEXT;
+                return;
+            case INSERTION:
+                if (stepInsertion()) { placed += frame.end - frame.begin; phase = NEXT; }
+                return;
+            case NETWORK:
+                networkSort(frame.begin, frame.end - frame.begin); placed += frame.end - frame.begin; phase = NEXT;
+                return;
+            case HEAP:
+                if (stepHeap()) { placed += frame.end - frame.begin; phase = NEXT; }
+                return;
+        }
+    }
+    int highlights(Highlight* out) const override {
+        if (done || phase == NEXT || frame.begin >= frame.end) return 0;
+        if (phase == NETWORK) { out[0] = {frame.begin, HIGHLIGHT_NETWORK, frame.end}; return 1; }
+        HighlightKind lane = phase == HEAP ? (HighlightKind)(HIGHLIGHT_LANE_0 + 1)
+                           : phase >= LEFT_SCAN_LAST && phase <= LEFT_LOOP_FIRST ? (HighlightKind)(HIGHLIGHT_LANE_0 + 2) : HIGHLIGHT_LANE_0;
+        out[0] = {frame.begin, lane, frame.end};
+        switch (phase) {
+            case INSERTION: case PARTIAL_LEFT: case PARTIAL_RIGHT: out[1] = {insJ, HIGHLIGHT_ACTIVE}; return 2;
+            case HEAP: return 1 + heapHighlights(out + 1);
+            case PIVOT: case BREAK_PATTERNS: return 1;
+            default:
+                out[1] = {frame.begin, HIGHLIGHT_MARKER};
+                out[2] = {std::min(first, n() - 1), HIGHLIGHT_ACTIVE}; out[3] = {std::min(last, n() - 1), HIGHLIGHT_ACTIVE};
+                return 4;
+        }
+    }
+    float progress() const override { return n() ? (float)placed / n() : 1.0f; }
+
+private:
+    struct Frame { int begin, end, badAllowed; bool leftmost; };
+    enum Phase {
+        NEXT, PIVOT,
+        RIGHT_SCAN_FIRST, RIGHT_SCAN_LAST, RIGHT_SWAP, RIGHT_LOOP_FIRST, RIGHT_LOOP_LAST,
+        LEFT_SCAN_LAST, LEFT_SCAN_FIRST, LEFT_SWAP, LEFT_LOOP_LAST, LEFT_LOOP_FIRST,
+        BREAK_PATTERNS, PARTIAL_LEFT, PARTIAL_RIGHT, INSERTION, NETWORK, HEAP
+    };
+    Frame* stack;
+    int depth = 0;
+    Frame frame{0, 0, 0, true};
+    Phase phase = NEXT;
+    int first = 0, last = 0, pivot = 0, placed = 0;
+    bool guarded = false, alreadyPartitioned = false;
+
+    // Begins work on `frame`: either a small-range insertion sort (or network) or pivot selection.
+    void startFrame() {
+        int size = frame.end - frame.begin;
+        if (size < PDQ_INSERTION_CUTOFF && networkLeaves) { phase = NETWORK; return; }
+        if (size < PDQ_INSERTION_CUTOFF) { beginInsertion(frame.begin, frame.end); phase = INSERTION; return; }
+        int b = frame.begin, e = frame.end, s2 = size / 2;
+        if (size > PDQ_NINTHER_THRESHOLD) {
+            queueSort3(b, b + s2, e - 1); queueSort3(b + 1, b + s2 - 1, e - 2);
+            queueSort3(b + 2, b + s2 + 1, e - 3); queueSort3(b + s2 - 1, b + s2, b + s2 + 1);
+            queueSwap(b, b + s2);
+        } else {
+            queueSort3(b + s2, b, e - 1);
+        }
+        phase = PIVOT;
+    }
+
+    void finishRightScan() { alreadyPartitioned = first >= last; phase = RIGHT_SWAP; if (first >= last) rightDone(); }
+
+    void rightDone() {
+        pivot = first - 1;
+        swapAt(frame.begin, pivot);
+        placed++;
+        int size = frame.end - frame.begin;
+        int l = pivot - frame.begin, r = frame.end - (pivot + 1);
+        if (l < size / 8 || r < size / 8) {
+            if (--frame.badAllowed == 0) { placed--; beginHeap(frame.begin, frame.end); phase = HEAP; return; }
+            int b = frame.begin, e = frame.end, p = pivot;
+            if (l >= PDQ_INSERTION_CUTOFF) {
+                queueSwap(b, b + l / 4); queueSwap(p - 1, p - l / 4);
+                if (l > PDQ_NINTHER_THRESHOLD) { queueSwap(b + 1, b + (l / 4 + 1)); queueSwap(b + 2, b + (l / 4 + 2)); queueSwap(p - 2, p - (l / 4 + 1)); queueSwap(p - 3, p - (l / 4 + 2)); }
+            }
+            if (r >= PDQ_INSERTION_CUTOFF) {
+                queueSwap(p + 1, p + (1 + r / 4)); queueSwap(e - 1, e - r / 4);
+                if (r > PDQ_NINTHER_THRESHOLD) { queueSwap(p + 2, p + (2 + r / 4)); queueSwap(p + 3, p + (3 + r / 4)); queueSwap(e - 2, e - (1 + r / 4)); queueSwap(e - 3, e - (2 + r / 4)); }
+            }
+            if (queued) { phase = BREAK_PATTERNS; return; }
+            split();
+        } else if (alreadyPartitioned) {
+            placed--;
+            beginInsertion(frame.begin, pivot, PDQ_PARTIAL_INSERTION_LIMIT); phase = PARTIAL_LEFT;
+        } else {
+            split();
+        }
+    }
+
+    // Everything in [begin, pivot] equals the pivot and is in place; carry on with the rest.
+    void leftDone() {
+        pivot = last;
+        swapAt(frame.begin, pivot);
+        placed += pivot - frame.begin + 1;
+        frame.begin = pivot + 1;
+        startFrame();
+    }
+
+    // Sorts the left part next and leaves the right part on the stack.
+    void split() {
+        if (phase == PARTIAL_LEFT || phase == PARTIAL_RIGHT) placed++;
+        if (frame.end - (pivot + 1) > 1) pushTask(stack, depth, {pivot + 1, frame.end, frame.badAllowed, false});
+        else placed += frame.end - (pivot + 1);
+        frame.end = pivot;
+        startFrame();
+    }
+};
+
+// TimSort (after Tim Peters' listsort): natural runs are found and reversed when
+// strictly descending, short runs are extended to minrun with binary insertion, and a
+// stack of pending runs is merged under the usual length invariants. Merges first
+// gallop to trim what is already in place, then switch to galloping whenever one run
+// keeps winning. For simplicity every merge copies its left run to scratch and merges
+// forwards (listsort would copy the shorter run).
+class TimSortStepper : public SortStepper {
+public:
+    TimSortStepper(std::vector<int>& values, ScratchArena& arena)
+        : SortStepper(values), tmp(arena.allocate<int>(values.size())) {
+        int r = 0, len = n();
+        while (len >= TIM_MIN_MERGE) { r |= len & 1; len >>= 1; }
+        minRun = len + r;
+        done = n() < 2;
+    }
+
+    void step() override {
+        switch (phase) {
+            case RUN_START:
+                if (lo >= n()) { phase = FORCE_COLLAPSE; collapse(); return; }
+                if (lo + 1 >= n()) { runHi = lo + 1; runDone(); step(); return; }
+                soundValue = values[lo + 1];
+                descending = less(lo + 1, lo); runHi = lo + 2; phase = RUN_EXTEND;
+                return;
+            case RUN_EXTEND:
+                if (runHi < n()) {
+                    soundValue = values[runHi];
+                    bool smaller = less(runHi, runHi - 1);
+                    if (smaller == descending) { runHi++; return; }
+                }
+                if (descending) { revI = lo; revJ = runHi - 1; phase = REVERSE; }
+                else runDone();
+                if (runHi >= n()) step();
+                return;
+            case REVERSE:
+                if (revI < revJ) { swapAt(revI++, revJ--); return; }
+                runDone(); step();
+                return;
+            case BINARY_SEARCH:
+                if (searchLo < searchHi) {
+                    int mid = (searchLo + searchHi) / 2;
+                    soundValue = values[mid];
+                    if (less(insertAt, mid)) searchHi = mid; else searchLo = mid + 1;
+                    return;
+                }
+                phase = SHIFT; step();
+                return;
+            case SHIFT:
+                if (insertAt > searchLo) { swapAt(insertAt, insertAt - 1); insertAt--; return; }
+                if (++binaryStart < runHi) { insertAt = binaryStart; searchLo = lo; searchHi = binaryStart; phase = BINARY_SEARCH; step(); return; }
+                pushRun();
+                return;
+            case GALLOP:
+                if (!stepGallop()) return;
+                afterGallop();
+                return;
+            case COPY_TO_TMP: {
+                int end = std::min(copied + SCRATCH_COPY_CHUNK, len1);
+                noteRead(base1 + copied, base1 + end); noteTraffic(0, end - copied);
+                for (; copied < end; copied++) tmp[copied] = values[base1 + copied];
+                if (copied < len1) return;
+                // B's first element is known to precede everything left in A
+                cursor1 = 0; cursor2 = base2; dest = base1;
+                take(values[cursor2++]);
+                if (--len2 == 0) { phase = FLUSH_A; return; }
+                if (len1 == 1) { phase = FLUSH_B; return; }
+                count1 = count2 = 0; phase = MERGE_ONE;
+                return;
+            }
+            case MERGE_ONE:
+                if (lessValues(values[cursor2], tmp[cursor1], cursor2, dest)) {
+                    take(values[cursor2++]); count2++; count1 = 0;
+                    if (--len2 == 0) { endMerge(); return; }
+                } else {
+                    take(tmp[cursor1++]); count1++; count2 = 0;
+                    if (--len1 == 1) { endMerge(); return; }
+                }
+                if ((count1 | count2) >= minGallop) { beginGallop(values[cursor2], cursor2, tmp + cursor1, dest, len1, true); gallopStage = GALLOP_A; phase = GALLOP; }
+                return;
+            case COPY_A:
+                if (pendingCopy > 0) { take(tmp[cursor1++]); len1--; pendingCopy--; return; }
+                if (len1 <= 1) { endMerge(); step(); return; }
+                take(values[cursor2++]);
+                if (--len2 == 0) { endMerge(); return; }
+                beginGallop(tmp[cursor1], dest, values.data() + cursor2, cursor2, len2, false); gallopStage = GALLOP_B; phase = GALLOP;
+                return;
+            case COPY_B:
+                if (pendingCopy > 0) { take(values[cursor2++]); len2--; pendingCopy--; return; }
+                if (len2 == 0) { endMerge(); step(); return; }
+                take(tmp[cursor1++]);
+                if (--len1 == 1) { endMerge(); return; }
+                minGallop--;
+                if (count1 >= TIM_MIN_GALLOP || count2 >= TIM_MIN_GALLOP) { beginGallop(values[cursor2], cursor2, tmp + cursor1, dest, len1, true); gallopStage = GALLOP_A; phase = GALLOP; return; }
+                if (minGallop < 0) minGallop = 0;
+                minGallop += 2;
+                count1 = count2 = 0; phase = MERGE_ONE;
+                return;
+            case FLUSH_B:
+                if (len2 > 0) { take(values[cursor2++]); len2--; return; }
+                take(tmp[cursor1]);
+                mergeDone();
+                return;
+            case FLUSH_A:
+                if (len1 > 0) { take(tmp[cursor1++]); len1--; if (len1 > 0) return; }
+                mergeDone();
+                return;
+            case COLLAPSE: case FORCE_COLLAPSE:
+                collapse();
+                if (!done) step();
+                return;
+        }
+    }
+    int highlights(Highlight* out) const override {
+        if (done) return 0;
+        if (phase >= GALLOP && phase <= FLUSH_A) {
+            out[0] = {mergeLo, HIGHLIGHT_LANE_0, mergeHi};
+            if (phase == GALLOP || phase == COPY_TO_TMP) return 1;
+            out[1] = {std::max(dest - 1, 0), HIGHLIGHT_WRITE};
+            return 2;
+        }
+        if (lo >= n()) return 0;
+        out[0] = {lo, (HighlightKind)(HIGHLIGHT_LANE_0 + 1), std::min(runHi, n())};
+        int active = phase == BINARY_SEARCH || phase == SHIFT ? insertAt : phase == REVERSE ? revI : std::min(runHi, n() - 1);
+        out[1] = {active, HIGHLIGHT_ACTIVE};
+        return 2;
+    }
+    // Half for scanning runs, half for the merges still pending once the scan is over.
+    float progress() const override {
+        if (n() == 0) return 1.0f;
+        float scanned = (float)std::min(lo, n()) / n();
+        if (lo < n()) return 0.5f * scanned;
+        return 0.5f + 0.5f * (forcePeak > 1 ? (float)(forcePeak - pending) / (forcePeak - 1) : 1.0f);
+    }
+
+private:
+    enum Phase {
+        RUN_START, RUN_EXTEND, REVERSE, BINARY_SEARCH, SHIFT, COLLAPSE, FORCE_COLLAPSE,
+        GALLOP, COPY_TO_TMP, MERGE_ONE, COPY_A, COPY_B, FLUSH_B, FLUSH_A
+    };
+    enum GallopStage { TRIM_A, TRIM_B, GALLOP_A, GALLOP_B };
+    int* tmp;
+    Phase phase = RUN_START;
+    int minRun = 0, minGallop = TIM_MIN_GALLOP;
+    int lo = 0, runHi = 0, revI = 0, revJ = 0, binaryStart = 0, insertAt = 0, searchLo = 0, searchHi = 0;
+    bool descending = false;
+    int runBase[TIM_MAX_PENDING_RUNS], runLen[TIM_MAX_PENDING_RUNS];
+    int pending = 0, forcePeak = 0;
+    // The merge in progress
+    int mergeAt = 0, base1 = 0, len1 = 0, base2 = 0, len2 = 0, mergeLo = 0, mergeHi = 0;
+    int cursor1 = 0, cursor2 = 0, dest = 0, count1 = 0, count2 = 0, copied = 0, pendingCopy = 0;
+    GallopStage gallopStage = TRIM_A;
+    // Gallop search: exponential probing from the start, then a binary search
+    int gKey = 0, gKeyIndex = 0, gBaseIndex = 0, gLen = 0, gLast = 0, gOfs = 0, gResult = 0;
+    const int* gBase = nullptr;
+    bool gRight = false;
+    int gPhase = 0;
+
+    bool lessValues(int a, int b, int aIndex, int bIndex) { noteCompare(aIndex, bIndex); return a < b; }
+    void take(int v) { soundValue = v; write(dest++, v); }
+
+    void runDone() {
+        int runLength = runHi - lo;
+        if (runLength < minRun) {
+            int force = std::min(n() - lo, minRun);
+            binaryStart = runHi; runHi = lo + force;
+            if (binaryStart < runHi) { insertAt = binaryStart; searchLo = lo; searchHi = binaryStart; phase = BINARY_SEARCH; return; }
+        }
+        pushRun();
+    }
+    void pushRun() {
+        runBase[pending] = lo; runLen[pending] = runHi - lo; pending++;
+        noteAux(runStackBytes(pending));
+        lo = runHi;
+        phase = COLLAPSE;
+    }
+
+    // Merges while the pending runs break the length invariants (or, at the end, until one is left).
+    void collapse() {
+        if (phase == FORCE_COLLAPSE) {
+            if (forcePeak == 0) forcePeak = pending;
+            if (pending <= 1) { done = true; return; }
+            int k = pending - 2;
+            if (k > 0 && runLen[k - 1] < runLen[k + 1]) k--;
+            beginMerge(k);
+            return;
+        }
+        if (pending > 1) {
+            int k = pending - 2;
+            if ((k > 0 && runLen[k - 1] <= runLen[k] + runLen[k + 1]) || (k > 1 && runLen[k - 2] <= runLen[k - 1] + runLen[k])) {
+                if (runLen[k - 1] < runLen[k + 1]) k--;
+                beginMerge(k); return;
+            }
+            if (runLen[k] <= runLen[k + 1]) { beginMerge(k); return; }
+        }
+        phase = RUN_START;
+    }
+
+    void beginMerge(int k) {
+        mergeAt = k;
+        base1 = runBase[k]; len1 = runLen[k]; base2 = runBase[k + 1]; len2 = runLen[k + 1];
+        mergeLo = base1; mergeHi = base2 + len2;
+        runLen[k] = len1 + len2;
+        if (k == pending - 3) { runBase[k + 1] = runBase[k + 2]; runLen[k + 1] = runLen[k + 2]; }
+        pending--;
+        resumePhase = phase == FORCE_COLLAPSE ? FORCE_COLLAPSE : COLLAPSE;
+        // Where does B's first element go in A? Everything before it stays put.
+        beginGallop(values[base2], base2, values.data() + base1, base1, len1, true);
+        gallopStage = TRIM_A; phase = GALLOP;
+    }
+    Phase resumePhase = COLLAPSE;
+
+    void afterGallop() {
+        switch (gallopStage) {
+            case TRIM_A:
+                base1 += gResult; len1 -= gResult;
+                if (len1 == 0) { mergeDone(); return; }
+                // Where does A's last element go in B? Everything after it stays put.
+                beginGallop(values[base1 + len1 - 1], base1 + len1 - 1, values.data() + base2, base2, len2, false);
+                gallopStage = TRIM_B;
+                return;
+            case TRIM_B:
+                len2 = gResult;
+                if (len2 == 0) { mergeDone(); return; }
+                copied = 0; phase = COPY_TO_TMP;
+                noteAux((size_t)len1 * sizeof(int) + runStackBytes(pending + 1)); // The merged pair is still pending
+                return;
+            case GALLOP_A: count1 = pendingCopy = gResult; phase = COPY_A; return;
+            case GALLOP_B: count2 = pendingCopy = gResult; phase = COPY_B; return;
+        }
+    }
+
+    void endMerge() {
+        if (minGallop < 1) minGallop = 1;
+        phase = len1 == 1 ? FLUSH_B : FLUSH_A;
+    }
+    void mergeDone() { phase = resumePhase; }
+    // Aux memory is the run stack in use plus the left run's copy in tmp during a merge.
+    static size_t runStackBytes(int runs) { return runs * (sizeof(runBase[0]) + sizeof(runLen[0])); }
+
+    // Counts the elements of base[0, len) that are <= key (right) or < key (left).
+    void beginGallop(int key, int keyIndex, const int* base, int baseIndex, int len, bool right) {
+        gKey = key; gKeyIndex = keyIndex; gBase = base; gBaseIndex = baseIndex; gLen = len; gRight = right; gPhase = 0;
+    }
+    // True when `base[k]` still belongs before the key.
+    bool gallopBefore(int k) {
+        return gRight ? !lessValues(gKey, gBase[k], gKeyIndex, gBaseIndex + k) : lessValues(gBase[k], gKey, gBaseIndex + k, gKeyIndex);
+    }
+    bool stepGallop() {
+        soundValue = gKey;
+        if (gPhase == 0) {
+            if (!gallopBefore(0)) { gResult = 0; return true; }
+            gLast = 0; gOfs = 1; gPhase = 1;
+            return false;
+        }
+        if (gPhase == 1) {
+            if (gOfs < gLen && gallopBefore(gOfs)) { gLast = gOfs; gOfs = gOfs * 2 + 1; return false; }
+            gOfs = std::min(gOfs, gLen); gLast++; gPhase = 2;
+            if (gLast >= gOfs) { gResult = gOfs; return true; }
+            return false;
+        }
+        int m = gLast + (gOfs - gLast) / 2;
+        if (gallopBefore(m)) gLast = m + 1; else gOfs = m;
+        if (gLast < gOfs) return false;
+        gResult = gOfs;
+        return true;
+    }
+};
+
+// --- IN-PLACE SORTS ---
+// Sorts that trade time for memory: heapsort and Shell sort need no scratch at all, and
+// the in-place merge sort stays stable with only a stack of O(log N) pending merges,
+// where MERGE_SORT needs a second copy of the array. Compare their Aux Memory lines (and
+// the bench's peak_aux_bytes) with the comparisons and time they spend instead.
+const int IN_PLACE_LEAF_SIZE = 16;   // Blocks this small are insertion sorted before merging
+const int IN_PLACE_MAX_FRAMES = 96;  // Each split leaves at most 3/4 of a merge, so log_{4/3} 2^31 fits
+const int MAX_SHELL_GAPS = 32;
+
+// Plain heapsort over the whole array: the hybrids' fallback on its own. Not stable.
+class HeapSortStepper : public HybridSortStepper {
+public:
+    explicit HeapSortStepper(std::vector<int>& values) : HybridSortStepper(values) {
+        beginHeap(0, n());
+        done = n() < 2;
+    }
+
+    void step() override { if (!done) done = stepHeap(); }
+    int highlights(Highlight* out) const override { return done ? 0 : heapHighlights(out); }
+    // Building the heap is roughly a tenth of the work; each extraction then places one element.
+    float progress() const override {
+        if (done) return 1.0f;
+        if (heapBuilding) return 0.1f * (1.0f - (float)(heapStart + 1) / (n() / 2));
+        return 0.1f + 0.9f * (n() - heapEnd) / n();
+    }
+    void sortedRange(int& begin, int& end) const override { begin = done ? 0 : heapBuilding ? n() : heapEnd; end = n(); }
+};
+
+// Stable merge sort without a merge buffer: insertion-sorted leaf blocks, then bottom-up
+// passes that merge neighbouring runs by rotation (the SymMerge/std::inplace_merge
+// fallback). A merge binary searches where the middle of the longer run splits the
+// other one, rotates the two inner pieces past each other with three reversals and
+// leaves two smaller merges on its stack. Runs that are already in order cost one
+// comparison. O(N log^2 N) moves, versus N extra elements for MERGE_SORT.
+class InPlaceMergeSortStepper : public HybridSortStepper {
+public:
+    explicit InPlaceMergeSortStepper(std::vector<int>& values) : HybridSortStepper(values) {
+        done = n() < 2;
+        for (int w = IN_PLACE_LEAF_SIZE; w < n(); w *= 2) totalPasses++;
+        if (!done) beginInsertion(0, std::min(IN_PLACE_LEAF_SIZE, n()));
+    }
+
+    void step() override {
+        switch (phase) {
+            case LEAVES:
+                if (!stepInsertion()) return;
+                leftStart += IN_PLACE_LEAF_SIZE;
+                if (leftStart < n()) { beginInsertion(leftStart, std::min(leftStart + IN_PLACE_LEAF_SIZE, n())); return; }
+                leftStart = 0; pass++; phase = NEXT;
+                return;
+            case NEXT: nextMerge(); return;
+            case POP: {
+                int len1 = 0, len2 = 0;
+                while (depth > 0 && (len1 == 0 || len2 == 0)) {
+                    frame = frames[--depth];
+                    len1 = frame.middle - frame.first; len2 = frame.last - frame.middle;
+                }
+                if (len1 == 0 || len2 == 0) { leftStart += 2 * width; phase = NEXT; nextMerge(); return; }
+                if (len1 + len2 == 2) { soundValue = values[frame.middle]; if (less(frame.middle, frame.first)) swapAt(frame.first, frame.middle); return; }
+                // Split the longer run in half and find the matching cut in the other
+                if (len1 > len2) { cut1 = key = frame.first + len1 / 2; searchLo = frame.middle; searchHi = frame.last; lowerBound = true; }
+                else { cut2 = key = frame.middle + len2 / 2; searchLo = frame.first; searchHi = frame.middle; lowerBound = false; }
+                phase = SEARCH;
+                step();
+                return;
+            }
+            case SEARCH: {
+                // Lower bound in the right run, upper bound in the left, so equal keys keep their order
+                int probe = searchLo + (searchHi - searchLo) / 2;
+                soundValue = values[probe];
+                if (lowerBound ? less(probe, key) : !less(key, probe)) searchLo = probe + 1; else searchHi = probe;
+                if (searchLo < searchHi) return;
+                (lowerBound ? cut2 : cut1) = searchLo;
+                newMiddle = cut1 + (cut2 - frame.middle);
+                if (cut1 == frame.middle || cut2 == frame.middle) { split(); return; } // Nothing to rotate
+                revStage = 0; beginReverse(cut1, frame.middle); phase = ROTATE;
+                return;
+            }
+            case ROTATE:
+                while (revLo >= revHi) {
+                    if (++revStage == 3) { split(); step(); return; }
+                    if (revStage == 1) beginReverse(frame.middle, cut2); else beginReverse(cut1, cut2);
+                }
+                soundValue = values[revLo];
+                swapAt(revLo++, revHi--);
+                return;
+        }
+    }
+    int highlights(Highlight* out) const override {
+        if (done) return 0;
+        switch (phase) {
+            case LEAVES: out[0] = {insBegin, HIGHLIGHT_LANE_0, insEnd}; out[1] = {insJ, HIGHLIGHT_ACTIVE}; return 2;
+            case SEARCH:
+                out[0] = {frame.first, HIGHLIGHT_LANE_0, frame.last}; out[1] = {key, HIGHLIGHT_MARKER};
+                out[2] = {searchLo + (searchHi - searchLo) / 2, HIGHLIGHT_ACTIVE};
+                return 3;
+            case ROTATE:
+                out[0] = {cut1, (HighlightKind)(HIGHLIGHT_LANE_0 + 1), cut2};
+                if (revLo >= revHi) return 1;
+                out[1] = {revLo, HIGHLIGHT_ACTIVE}; out[2] = {revHi, HIGHLIGHT_ACTIVE};
+                return 3;
+            default: return 0;
+        }
+    }
+    // The leaf pass and every merge pass count the same.
+    float progress() const override {
+        return done ? 1.0f : (pass + (float)std::min(leftStart, n()) / n()) / (totalPasses + 1);
+    }
+
+private:
+    struct Frame { int first, middle, last; }; // Merge [first, middle) with [middle, last)
+    enum Phase { LEAVES, NEXT, POP, SEARCH, ROTATE };
+    Phase phase = LEAVES;
+    Frame frames[IN_PLACE_MAX_FRAMES];
+    int depth = 0;
+    Frame frame{0, 0, 0};
+    int width = IN_PLACE_LEAF_SIZE, leftStart = 0, pass = 0, totalPasses = 0;
+    int cut1 = 0, cut2 = 0, newMiddle = 0, key = 0, searchLo = 0, searchHi = 0;
+    int revLo = 0, revHi = 0, revStage = 0;
+    bool lowerBound = false;
+
+    // Starts the next pair of runs of this pass, or the next pass.
+    void nextMerge() {
+        if (leftStart + width >= n()) {
+            width *= 2; leftStart = 0; pass++;
+            done = width >= n();
+            return;
+        }
+        int middle = leftStart + width;
+        soundValue = values[middle];
+        if (!less(middle, middle - 1)) { leftStart += 2 * width; return; } // Already in order
+        depth = 0;
+        pushTask(frames, depth, {leftStart, middle, std::min(leftStart + 2 * width, n())});
+        phase = POP;
+    }
+    void beginReverse(int begin, int end) { revLo = begin; revHi = end - 1; }
+    // The left half is merged next; the right one waits below it.
+    void split() {
+        pushTask(frames, depth, {newMiddle, cut2, frame.last});
+        pushTask(frames, depth, {frame.first, cut1, newMiddle});
+        phase = POP;
+    }
+};
+
+// Fills gaps with `sequence`'s Shell sort gaps below n, largest first, and returns how
+// many there are: Ciura's measured 1, 4, 10, .., 701 extended by x2.25, Knuth's
+// (3^k - 1) / 2, or Shell's original N/2, N/4, .., 1.
+int ShellGaps(SortMode sequence, int n, int* gaps);
+
+// Insertion sort over every gap in turn, one comparison per step. In place and not stable.
+class ShellSortStepper : public SortStepper {
+public:
+    ShellSortStepper(std::vector<int>& values, SortMode sequence) : SortStepper(values) {
+        gapCount = ShellGaps(sequence, n(), gaps);
+        done = gapCount == 0;
+        if (!done) { noteAux(gapCount * sizeof(int)); startGap(); }
+    }
+
+    void step() override {
+        if (done) return;
+        soundValue = values[j];
+        if (j >= gap && less(j, j - gap)) { swapAt(j, j - gap); j -= gap; return; }
+        if (++i < n()) { j = i; return; }
+        if (++gapIndex == gapCount) done = true; else startGap();
+    }
+    int highlights(Highlight* out) const override {
+        if (done) return 0;
+        out[0] = {j, HIGHLIGHT_ACTIVE};
+        if (j < gap) return 1;
+        out[1] = {j - gap, HIGHLIGHT_MARKER};
+        return 2;
+    }
+    float progress() const override {
+        return done ? 1.0f : (gapIndex + (float)(i - gap) / (n() - gap)) / gapCount;
+    }
+
+private:
+    int gaps[MAX_SHELL_GAPS];
+    int gapCount = 0, gapIndex = 0, gap = 1, i = 0, j = 0;
+
+    void startGap() { gap = gaps[gapIndex]; i = j = gap; }
+};
+
+// --- NON-COMPARISON SORTS ---
+// Counting sort and radix sorts never compare two elements: they read each key and
+// write it into its bucket, which is O(N) for bounded keys like ours. Reads are not
+// counted, so Comparisons stays at zero (apart from MSD's small-range insertion sorts)
+// and Swaps counts the writes. While stepping live, the bucket being filled is tinted.
+const int COUNTING_MAX_BUCKETS = 1 << 22;  // Wider value spans use LSD radix sort instead
+const int RADIX_BITS = 8;
+const int RADIX_BUCKETS = 1 << RADIX_BITS;
+const int RADIX_DIGITS = 32 / RADIX_BITS;
+const int MSD_INSERTION_CUTOFF = 16;
+
+// Unsigned key with the same order as the int, so negative values sort first too.
+inline uint32_t RadixKey(int v) { return (uint32_t)v ^ 0x80000000u; }
+inline int RadixDigit(int v, int digit) { return (int)((RadixKey(v) >> (digit * RADIX_BITS)) & (RADIX_BUCKETS - 1)); }
+
+void ValueBounds(const std::vector<int>& values, int& lo, int& hi);
+
+// Counts every value, then writes each bucket's values out in order.
+class CountingSortStepper : public SortStepper {
+public:
+    CountingSortStepper(std::vector<int>& values, ScratchArena& arena, int minValue, int maxValue)
+        : SortStepper(values), minValue(minValue), buckets(maxValue - minValue + 1), counts(arena.allocate<int>(buckets)) {
+        std::fill(counts, counts + buckets, 0);
+        done = n() < 2;
+        if (!done) noteAux(buckets * sizeof(int));
+    }
+
+    void step() override {
+        if (i < n()) { soundValue = values[i]; counts[values[i] - minValue]++; noteRead(i, i + 1); i++; return; }
+        while (bucket < buckets && written == bucketEnd) bucketStart = written, bucketEnd += counts[bucket++];
+        soundValue = minValue + bucket - 1;
+        write(written++, soundValue);
+        done = written >= n();
+    }
+    int highlights(Highlight* out) const override {
+        if (done) return 0;
+        if (i < n()) { out[0] = {i, HIGHLIGHT_ACTIVE}; return 1; }
+        out[0] = {bucketStart, HIGHLIGHT_LANE_0, bucketEnd}; out[1] = {std::max(written - 1, 0), HIGHLIGHT_WRITE};
+        return 2;
+    }
+    float progress() const override { return n() ? 0.5f * (i + written) / n() : 1.0f; }
+    void sortedRange(int& begin, int& end) const override { begin = 0; end = i < n() ? 0 : bucketStart; }
+
+private:
+    int minValue, buckets;
+    int* counts;
+    int i = 0, bucket = 0, bucketStart = 0, bucketEnd = 0, written = 0;
+};
+
+// Least significant digit first: one read pass counts all four digits at once, then
+// every digit that is not the same for all keys gets a pass that copies the array to
+// scratch and scatters it back, each bucket filling up from its own start.
+class LsdRadixSortStepper : public SortStepper {
+public:
+    LsdRadixSortStepper(std::vector<int>& values, ScratchArena& arena)
+        : SortStepper(values), scratch(arena.allocate<int>(values.size())) {
+        for (auto& h : hist) std::fill(std::begin(h), std::end(h), 0);
+        done = n() < 2;
+        if (!done) noteAux(n() * sizeof(int) + sizeof(hist) + sizeof(start) + sizeof(fill));
+    }
+
+    void step() override {
+        switch (phase) {
+            case HISTOGRAM:
+                soundValue = values[i];
+                for (int d = 0; d < RADIX_DIGITS; d++) hist[d][RadixDigit(values[i], d)]++;
+                noteRead(i, i + 1);
+                if (++i < n()) return;
+                for (int d = 0; d < RADIX_DIGITS; d++) if (!constantDigit(d)) passes++;
+                nextPass();
+                return;
+            case COPY: {
+                int end = std::min(i + SCRATCH_COPY_CHUNK, n());
+                noteRead(i, end); noteTraffic(0, end - i);
+                for (; i < end; i++) scratch[i] = values[i];
+                if (i == n()) { i = 0; phase = SCATTER; }
+                return;
+            }
+            case SCATTER: {
+                int v = scratch[i++];
+                bucket = RadixDigit(v, digit);
+                soundValue = v;
+                write(fill[bucket]++, v);
+                if (i == n()) { donePasses++; digit++; nextPass(); }
+                return;
+            }
+        }
+    }
+    int highlights(Highlight* out) const override {
+        if (done) return 0;
+        if (phase == HISTOGRAM) { out[0] = {i, HIGHLIGHT_ACTIVE}; return 1; }
+        if (phase == COPY || i == 0) return 0;
+        out[0] = {start[bucket], (HighlightKind)(HIGHLIGHT_LANE_0 + bucket % PARALLEL_LANES), fill[bucket]};
+        out[1] = {fill[bucket] - 1, HIGHLIGHT_WRITE};
+        return 2;
+    }
+    // The read pass counts as one pass, like each scatter.
+    float progress() const override {
+        if (done) return 1.0f;
+        if (phase == HISTOGRAM) return (float)i / n() / (1 + RADIX_DIGITS);
+        float current = phase == SCATTER ? (float)i / n() : 0.0f;
+        return (1 + donePasses + current) / (1 + passes);
+    }
+
+private:
+    enum Phase { HISTOGRAM, COPY, SCATTER };
+    int* scratch;
+    int hist[RADIX_DIGITS][RADIX_BUCKETS];
+    int start[RADIX_BUCKETS] = {}, fill[RADIX_BUCKETS] = {};
+    Phase phase = HISTOGRAM;
+    int i = 0, digit = 0, bucket = 0, passes = 0, donePasses = 0;
+
+    bool constantDigit(int d) const { return *std::max_element(hist[d], hist[d] + RADIX_BUCKETS) == n(); }
+
+    void nextPass() {
+        while (digit < RADIX_DIGITS && constantDigit(digit)) digit++;
+        if (digit == RADIX_DIGITS) { done = true; return; }
+        for (int b = 0, sum = 0; b < RADIX_BUCKETS; b++) { start[b] = fill[b] = sum; sum += hist[digit][b]; }
+        i = 0; phase = COPY;
+    }
+};
+
+// Most significant digit first, in place (American flag sort): each range is counted
+// by its current digit, then elements are swapped straight into their buckets, and
+// every bucket is sorted by the next digit. Ranges of up to 16 elements are insertion
+// (or network) sorted instead. The first pass counts all digits so constant leading ones are skipped.
+class MsdRadixSortStepper : public HybridSortStepper {
+public:
+    MsdRadixSortStepper(std::vector<int>& values, ScratchArena& arena, bool networkLeaves = false)
+        : HybridSortStepper(values, networkLeaves), stack(arena.allocate<Task>(values.size() / 2 + 1)) {
+        if (n() > 1) pushTask(stack, depth, {0, n(), RADIX_DIGITS - 1});
+        else placed = n();
+        for (auto& h : topHist) std::fill(std::begin(h), std::end(h), 0);
+        tables = sizeof(topHist) + sizeof(count) + sizeof(head) + sizeof(tail);
+        noteAux(tables + depth * sizeof(Task));
+    }
+
+    void step() override {
+        switch (phase) {
+            case NEXT: {
+                if (depth == 0) { done = true; return; }
+                task = stack[--depth];
+                if (task.hi - task.lo <= MSD_INSERTION_CUTOFF && networkLeaves) { phase = NETWORK; return; }
+                if (task.hi - task.lo <= MSD_INSERTION_CUTOFF) { beginInsertion(task.lo, task.hi); phase = INSERTION; step(); return; }
+                std::fill(std::begin(count), std::end(count), 0);
+                i = task.lo; phase = topLevel ? HISTOGRAM_ALL : HISTOGRAM;
+                step();
+                return;
+            }
+            case HISTOGRAM_ALL:
+                soundValue = values[i];
+                for (int d = 0; d < RADIX_DIGITS; d++) topHist[d][RadixDigit(values[i], d)]++;
+                noteRead(i, i + 1);
+                if (++i < task.hi) return;
+                topLevel = false;
+                while (task.digit > 0 && *std::max_element(topHist[task.digit], topHist[task.digit] + RADIX_BUCKETS) == n()) task.digit--;
+                std::copy(std::begin(topHist[task.digit]), std::end(topHist[task.digit]), count);
+                beginPermute();
+                return;
+            case HISTOGRAM:
+                soundValue = values[i];
+                count[RadixDigit(values[i], task.digit)]++;
+                noteRead(i, i + 1);
+                if (++i < task.hi) return;
+                beginPermute();
+                return;
+            case PERMUTE: {
+                while (bucket < RADIX_BUCKETS && head[bucket] >= tail[bucket]) bucket++;
+                if (bucket == RADIX_BUCKETS) { split(); return; }
+                int v = values[head[bucket]];
+                int d = RadixDigit(v, task.digit);
+                soundValue = v;
+                if (d == bucket) { noteRead(head[bucket], head[bucket] + 1); head[bucket]++; }
+                else swapAt(head[bucket], head[d]++);
+                return;
+            }
+            case INSERTION:
+                if (stepInsertion()) { placed += task.hi - task.lo; phase = NEXT; }
+                return;
+            case NETWORK:
+                networkSort(task.lo, task.hi - task.lo); placed += task.hi - task.lo; phase = NEXT;
+                return;
+        }
+    }
+    int highlights(Highlight* out) const override {
+        if (done || phase == NEXT) return 0;
+        if (phase == NETWORK) { out[0] = {task.lo, HIGHLIGHT_NETWORK, task.hi}; return 1; }
+        out[0] = {task.lo, HIGHLIGHT_LANE_0, task.hi};
+        switch (phase) {
+            case HISTOGRAM: case HISTOGRAM_ALL: out[1] = {std::min(i, n() - 1), HIGHLIGHT_ACTIVE}; return 2;
+            case INSERTION: out[1] = {insJ, HIGHLIGHT_ACTIVE}; return 2;
+            default:
+                if (bucket == RADIX_BUCKETS) return 1;
+                out[1] = {tail[bucket] - count[bucket], (HighlightKind)(HIGHLIGHT_LANE_0 + 1 + bucket % (PARALLEL_LANES - 1)), head[bucket]};
+                out[2] = {std::min(head[bucket], n() - 1), HIGHLIGHT_ACTIVE};
+                return 3;
+        }
+    }
+    float progress() const override { return n() ? (float)placed / n() : 1.0f; }
+
+private:
+    struct Task { int lo, hi, digit; };
+    enum Phase { NEXT, HISTOGRAM_ALL, HISTOGRAM, PERMUTE, INSERTION, NETWORK };
+    Task* stack;
+    int depth = 0;
+    Task task{0, 0, 0};
+    Phase phase = NEXT;
+    bool topLevel = true;
+    int topHist[RADIX_DIGITS][RADIX_BUCKETS];
+    int count[RADIX_BUCKETS] = {}, head[RADIX_BUCKETS] = {}, tail[RADIX_BUCKETS] = {};
+    size_t tables = 0;  // Bytes of the count tables above
+    int i = 0, bucket = 0, placed = 0;
+
+    void beginPermute() {
+        for (int b = 0, sum = task.lo; b < RADIX_BUCKETS; b++) { head[b] = sum; sum += count[b]; tail[b] = sum; }
+        bucket = 0; phase = PERMUTE;
+    }
+
+    // Buckets are pushed last first, so they are sorted left to right.
+    void split() {
+        for (int b = RADIX_BUCKETS - 1; b >= 0; b--) {
+            int size = count[b], lo = tail[b] - size;
+            if (size > 1 && task.digit > 0) stack[depth++] = {lo, tail[b], task.digit - 1};
+            else placed += size;  // A lone element, or keys equal in every digit
+        }
+        noteAux(tables + depth * sizeof(Task));
+        phase = NEXT;
+    }
+};
+
+// Plays a recorded OperationTrace back onto the array. Unlike live steppers it can
+// also run backwards, because every recorded operation is its own inverse.
+class TraceReplayStepper : public SortStepper {
+public:
+    TraceReplayStepper(std::vector<int>& values, const OperationTrace& ops, const std::vector<int>& initial)
+        : SortStepper(values), ops(ops), initial(initial) { done = ops.size() == 0; }
+
+    void step() override {
+        if (position >= ops.size()) { done = true; return; }
+        if (ops[position].type() == OP_NETWORK) { applyNetwork(position, 1); position += NetworkOps(ops[position]); }
+        else { apply(ops[position], 1); position++; }
+        done = position >= ops.size();
+    }
+    void stepBack() {
+        if (position == 0) return;
+        if (ops[position - 1].type() == OP_NETWORK) { position -= NetworkOps(ops[position - 1]); applyNetwork(position, -1); }
+        else { position--; apply(ops[position], -1); }
+        done = false;
+    }
+    // Jumps straight back to the recorded input without undoing each operation.
+    void rewind() {
+        std::copy(initial.begin(), initial.end(), values.begin());
+        position = 0; comparisons = 0; swaps = 0; soundValue = 0;
+        done = ops.size() == 0;
+        if (observer) observer->onReset();
+    }
+
+    int highlights(Highlight* out) const override {
+        if (position == 0) return 0;
+        const TraceOp& op = ops[position - 1];
+        if (op.type() == OP_WRITE) { out[0] = {op.index(), HIGHLIGHT_WRITE}; return 1; }
+        if (op.type() == OP_NETWORK) { out[0] = {op.index(), HIGHLIGHT_NETWORK, op.index() + (op.arg & 0xFF)}; return 1; }
+        out[0] = {op.index(), HIGHLIGHT_ACTIVE}; out[1] = {op.arg, HIGHLIGHT_ACTIVE};
+        return 2;
+    }
+    float progress() const override { return ops.size() ? (float)position / ops.size() : 1.0f; }
+
+    size_t position = 0;
+
+private:
+    const OperationTrace& ops;
+    const std::vector<int>& initial;
+
+    void apply(const TraceOp& op, int direction) {
+        int a = op.index();
+        switch (op.type()) {
+            case OP_COMPARE:
+                comparisons += direction;
+                if (observer) { observer->onRead(a, a + 1); observer->onRead(op.arg, op.arg + 1); }
+                break;
+            case OP_SWAP: ObservedSwap(values, a, op.arg, observer); swaps += direction; break;
+            case OP_WRITE:
+                values[a] ^= op.arg; swaps += direction;
+                if (observer) observer->onWrite(a, values[a] ^ op.arg, values[a]);
+                break;
+            case OP_NETWORK: break;
+        }
+        soundValue = values[a];
+    }
+    // A network is its opening marker, its writes and a closing marker, replayed (or
+    // undone) as one step. The writes hit distinct elements, so their order is free.
+    static size_t NetworkOps(const TraceOp& marker) { return (size_t)(marker.arg >> 8) + 2; }
+    void applyNetwork(size_t start, int direction) {
+        const TraceOp& marker = ops[start];
+        size_t writes = NetworkOps(marker) - 2;
+        if (observer) observer->onRead(marker.index(), marker.index() + (marker.arg & 0xFF));
+        for (size_t k = 1; k <= writes; k++) apply(ops[start + k], direction);
+        comparisons += direction * NetworkComparators(marker.arg & 0xFF);
+        soundValue = values[marker.index() + (marker.arg & 0xFF) - 1];
+    }
+};
+
+// An unbiased Fisher-Yates shuffle, one swap per step. It is driven like a sort
+// so the shuffle animates (and sounds) through the same worker and snapshot path.
+class ShuffleStepper : public SortStepper {
+public:
+    ShuffleStepper(std::vector<int>& values, uint64_t seed) : SortStepper(values), rng(seed) { done = n() < 2; }
+
+    // Fisher-Yates: position i gets a uniformly chosen element of the rest
+    void step() override {
+        if (i >= n() - 1) { done = true; return; }
+        int r = i + (int)rng.below(n() - i);
+        ObservedSwap(values, i, r, observer);
+        soundValue = values[i]; i++;
+        done = i >= n() - 1;
+    }
+    int highlights(Highlight* out) const override {
+        if (i >= n() - 1) return 0;
+        out[0] = {i, HIGHLIGHT_ACTIVE};
+        return 1;
+    }
+    float progress() const override { return n() > 1 ? (float)i / (n() - 1) : 1.0f; }
+
+private:
+    Xoshiro256 rng;
+    int i = 0;
+};
+
+// --- BITONIC SORT ---
+// A sorting network for any N, in the form where every comparator puts the smaller key
+// at the lower index: blocks of 2, 4, 8... each start with a pass that compares mirrored
+// partners and continue with partners at halving distances. Keys past N behave as
+// +infinity and never move, so the network of the next power of two needs no padding.
+// Every pass is data-parallel, which is what GPU_BITONIC_SORT runs as one dispatch.
+struct BitonicPass {
+    uint32_t block = 2, distance = 1; // Partners are `distance` apart within blocks of `block`
+
+    bool flip() const { return distance * 2 == block; }
+    // The partner of a key whose `distance` bit is clear
+    uint32_t partner(uint32_t i) const { return flip() ? i ^ (block - 1) : i + distance; }
+    // Moves on to the next pass of a sort of n keys. False after the last.
+    bool advance(uint32_t n) {
+        if (distance > 1) { distance /= 2; return true; }
+        block *= 2; distance = block / 2;
+        return distance < n;
+    }
+};
+
+// Comparators of a pass whose partners are both below n: the same for flip passes.
+inline uint64_t BitonicComparators(uint32_t n, uint32_t distance) {
+    uint64_t span = 2ull * distance;
+    return n / span * distance + (n % span > distance ? n % span - distance : 0);
+}
+
+inline int BitonicPassCount(uint32_t n) {
+    int levels = n > 1 ? std::bit_width(n - 1) : 0;
+    return levels * (levels + 1) / 2;
+}
+
+// One comparator per step, pass by pass.
+class BitonicSortStepper : public SortStepper {
+public:
+    explicit BitonicSortStepper(std::vector<int>& values) : SortStepper(values) { done = n() < 2; seek(); }
+
+    void step() override {
+        if (done) return;
+        uint32_t j = pass.partner(i);
+        soundValue = values[j];
+        if (less(j, i)) swapAt(i, j);
+        i++;
+        seek();
+    }
+    int highlights(Highlight* out) const override {
+        if (done) return 0;
+        int blockStart = (int)(i & ~(pass.block - 1));
+        out[0] = {blockStart, HIGHLIGHT_LANE_0, std::min(blockStart + (int)pass.block, n())};
+        out[1] = {(int)i, HIGHLIGHT_ACTIVE}; out[2] = {(int)pass.partner(i), HIGHLIGHT_ACTIVE};
+        return 3;
+    }
+    float progress() const override { return done ? 1.0f : (passesDone + (float)i / n()) / BitonicPassCount(n()); }
+
+private:
+    BitonicPass pass;
+    uint32_t i = 0;
+    int passesDone = 0;
+
+    // Skips to the next comparator with both keys in the array, or finishes.
+    void seek() {
+        while (!done) {
+            for (; i < (uint32_t)n(); i++) if (!(i & pass.distance) && pass.partner(i) < (uint32_t)n()) return;
+            i = 0; passesDone++;
+            done = !pass.advance(n());
+        }
+    }
+};
+
+// --- GPU COMPUTE ---
+// Bitonic passes on the device through SDL3's GPU API. shaders/bitonic_pass.comp runs
+// one pass per dispatch over a storage buffer of int keys; CMake compiles it to
+// bitonic_pass.spv next to the executable when glslc is installed. SPIR-V means the
+// Vulkan backend only. Without a device or the shader ready() is false and the GPU sort
+// runs the same passes on the CPU. Workers share the device, so every call locks.
+const char* const GPU_SHADER_FILE = "bitonic_pass.spv";
+const Uint32 GPU_THREADS = 256;       // The shader's local_size_x
+const Uint32 GPU_MAX_GROUPS = 4096;   // Larger passes loop inside the shader
+const double GPU_READBACK_SECONDS = 1.0 / 60.0; // A visualized GPU sort reads its keys back at most this often
+const int MAX_BITONIC_PASSES = 32 * 33 / 2;     // Of any 32-bit N
+
+class GpuCompute {
+public:
+    // A device copy of an array of keys, with the staging buffer its read-backs go through.
+    struct Keys {
+        SDL_GPUBuffer* buffer = nullptr;
+        SDL_GPUTransferBuffer* download = nullptr;
+        Uint32 count = 0;
+    };
+
+    // Opens the device and the pipeline on first use.
+    bool ready() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!opened) open();
+        return pipeline != nullptr;
+    }
+    const char* status() const { return statusText.load(std::memory_order_acquire); }
+
+    bool upload(Keys& keys, const int* values, Uint32 count) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (count > UINT32_MAX / sizeof(int)) return false; // Buffer sizes are 32-bit
+        Uint32 bytes = count * sizeof(int);
+        SDL_GPUBufferCreateInfo bufferInfo{};
+        bufferInfo.usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE;
+        bufferInfo.size = bytes;
+        SDL_GPUTransferBufferCreateInfo stagingInfo{};
+        stagingInfo.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD; stagingInfo.size = bytes;
+        SDL_GPUTransferBuffer* staging = SDL_CreateGPUTransferBuffer(device, &stagingInfo);
+        stagingInfo.usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD;
+        keys = {SDL_CreateGPUBuffer(device, &bufferInfo), SDL_CreateGPUTransferBuffer(device, &stagingInfo), count};
+        void* mapped = staging ? SDL_MapGPUTransferBuffer(device, staging, false) : nullptr;
+        bool ok = keys.buffer && keys.download && mapped;
+        if (mapped) { std::memcpy(mapped, values, bytes); SDL_UnmapGPUTransferBuffer(device, staging); }
+        SDL_GPUCommandBuffer* commands = ok ? SDL_AcquireGPUCommandBuffer(device) : nullptr;
+        if (commands) {
+            SDL_GPUCopyPass* copy = SDL_BeginGPUCopyPass(commands);
+            SDL_GPUTransferBufferLocation source{staging, 0};
+            SDL_GPUBufferRegion target{keys.buffer, 0, bytes};
+            SDL_UploadToGPUBuffer(copy, &source, &target, false);
+            SDL_EndGPUCopyPass(copy);
+            ok = SDL_SubmitGPUCommandBuffer(commands);
+        }
+        if (staging) SDL_ReleaseGPUTransferBuffer(device, staging); // Freed once the copy is done
+        if (!ok || !commands) { releaseLocked(keys); return false; }
+        return true;
+    }
+
+    // Records `count` passes into one command buffer, a compute pass each so that every
+    // pass sees the previous one's writes, and submits them without waiting.
+    bool dispatch(Keys& keys, const BitonicPass* passes, int count) {
+        std::lock_guard<std::mutex> lock(mutex);
+        SDL_GPUCommandBuffer* commands = SDL_AcquireGPUCommandBuffer(device);
+        if (!commands) return false;
+        Uint32 comparators = std::bit_ceil(keys.count) / 2;
+        Uint32 groups = std::clamp((comparators + GPU_THREADS - 1) / GPU_THREADS, 1u, GPU_MAX_GROUPS);
+        SDL_GPUStorageBufferReadWriteBinding binding{};
+        binding.buffer = keys.buffer;
+        for (int p = 0; p < count; p++) {
+            PassUniforms uniforms{keys.count, passes[p].distance, passes[p].flip(), comparators};
+            SDL_PushGPUComputeUniformData(commands, 0, &uniforms, sizeof(uniforms));
+            SDL_GPUComputePass* compute = SDL_BeginGPUComputePass(commands, nullptr, 0, &binding, 1);
+            SDL_BindGPUComputePipeline(compute, pipeline);
+            SDL_DispatchGPUCompute(compute, groups, 1, 1);
+            SDL_EndGPUComputePass(compute);
+        }
+        return SDL_SubmitGPUCommandBuffer(commands);
+    }
+
+    // Waits for the submitted passes and copies the keys back.
+    bool download(Keys& keys, int* values) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Uint32 bytes = keys.count * sizeof(int);
+        SDL_GPUCommandBuffer* commands = SDL_AcquireGPUCommandBuffer(device);
+        if (!commands) return false;
+        SDL_GPUCopyPass* copy = SDL_BeginGPUCopyPass(commands);
+        SDL_GPUBufferRegion source{keys.buffer, 0, bytes};
+        SDL_GPUTransferBufferLocation target{keys.download, 0};
+        SDL_DownloadFromGPUBuffer(copy, &source, &target);
+        SDL_EndGPUCopyPass(copy);
+        SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(commands);
+        if (!fence) return false;
+        bool ok = SDL_WaitForGPUFences(device, true, &fence, 1);
+        SDL_ReleaseGPUFence(device, fence);
+        void* mapped = ok ? SDL_MapGPUTransferBuffer(device, keys.download, false) : nullptr;
+        if (!mapped) return false;
+        std::memcpy(values, mapped, bytes);
+        SDL_UnmapGPUTransferBuffer(device, keys.download);
+        return true;
+    }
+
+    void release(Keys& keys) {
+        std::lock_guard<std::mutex> lock(mutex);
+        releaseLocked(keys);
+    }
+
+    // Sorts in one go: upload, every pass in one command buffer, read back.
+    bool sort(int* values, Uint32 count) {
+        if (count < 2) return true;
+        BitonicPass passes[MAX_BITONIC_PASSES];
+        int total = 0;
+        BitonicPass pass;
+        do passes[total++] = pass; while (pass.advance(count));
+        Keys keys;
+        if (!upload(keys, values, count)) return false;
+        bool ok = dispatch(keys, passes, total) && download(keys, values);
+        release(keys);
+        return ok;
+    }
+
+    // Before SDL_Quit, after every stepper that used the device is gone.
+    void shutdown() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pipeline) SDL_ReleaseGPUComputePipeline(device, pipeline);
+        if (device) SDL_DestroyGPUDevice(device);
+        if (videoInit) SDL_QuitSubSystem(SDL_INIT_VIDEO);
+        pipeline = nullptr; device = nullptr; videoInit = false;
+    }
+
+private:
+    struct PassUniforms { Uint32 count, distance, flip, comparators; }; // The shader's std140 block
+
+    std::mutex mutex;
+    SDL_GPUDevice* device = nullptr;
+    SDL_GPUComputePipeline* pipeline = nullptr;
+    bool opened = false, videoInit = false;
+    std::atomic<const char*> statusText{"not opened yet"};
+
+    void open() {
+        opened = true;
+        videoInit = SDL_InitSubSystem(SDL_INIT_VIDEO); // The Vulkan loader comes with video; the bench never inits SDL
+        device = SDL_CreateGPUDevice(SDL_GPU_SHADERFORMAT_SPIRV, false, nullptr);
+        if (!device) { statusText.store("no Vulkan device, passes run on the CPU"); return; }
+        std::string path = std::string(SDL_GetBasePath() ? SDL_GetBasePath() : "") + GPU_SHADER_FILE;
+        size_t size = 0;
+        void* code = SDL_LoadFile(path.c_str(), &size);
+        if (!code) { statusText.store("bitonic_pass.spv not found, passes run on the CPU"); return; }
+        SDL_GPUComputePipelineCreateInfo info{};
+        info.code_size = size; info.code = (const Uint8*)code; info.entrypoint = "main";
+        info.format = SDL_GPU_SHADERFORMAT_SPIRV;
+        info.num_readwrite_storage_buffers = 1; info.num_uniform_buffers = 1;
+        info.threadcount_x = GPU_THREADS; info.threadcount_y = 1; info.threadcount_z = 1;
+        pipeline = SDL_CreateGPUComputePipeline(device, &info);
+        SDL_free(code);
+        statusText.store(pipeline ? "Vulkan compute" : "compute pipeline failed, passes run on the CPU");
+    }
+
+    void releaseLocked(Keys& keys) {
+        if (keys.buffer) SDL_ReleaseGPUBuffer(device, keys.buffer);
+        if (keys.download) SDL_ReleaseGPUTransferBuffer(device, keys.download);
+        keys = Keys();
+    }
+};
+
+extern GpuCompute gpuCompute;
+
+// A whole bitonic pass per step, dispatched on the GPU when there is one. The bars show
+// the keys read back at most every GPU_READBACK_SECONDS (only when observed; the bench
+// reads back once, at the end). The device counts no swaps. Without a device, or if it
+// fails mid-sort, the passes run here on the CPU, restarting from the last read-back.
+class GpuBitonicSortStepper : public SortStepper {
+public:
+    explicit GpuBitonicSortStepper(std::vector<int>& values) : SortStepper(values) {
+        done = n() < 2;
+        onDevice = !done && gpuCompute.ready() && gpuCompute.upload(keys, values.data(), n());
+        // The device copy plus its read-back buffer, and the upload's staging buffer while it lasts
+        if (onDevice) noteAux(3 * n() * sizeof(int));
+    }
+    ~GpuBitonicSortStepper() override { if (onDevice) gpuCompute.release(keys); }
+
+    void step() override {
+        if (done) return;
+        if (onDevice && !gpuCompute.dispatch(keys, &pass, 1)) { fallBack(); return; }
+        if (onDevice) { comparisons += BitonicComparators(n(), pass.distance); noteTraffic(2 * (int)BitonicComparators(n(), pass.distance), 0); }
+        else runPass();
+        passesDone++;
+        done = !pass.advance(n());
+        auto now = std::chrono::steady_clock::now();
+        if (onDevice && (done || (observer && now - lastReadback >= std::chrono::duration<double>(GPU_READBACK_SECONDS)))) {
+            lastReadback = now;
+            if (!gpuCompute.download(keys, values.data())) { fallBack(); return; }
+            soundValue = values[n() / 2];
+            if (observer) observer->onReset();
+        }
+    }
+    int highlights(Highlight* out) const override {
+        if (done) return 0;
+        out[0] = {0, HIGHLIGHT_NETWORK, std::min((int)pass.block, n())}; // The first block of the pass
+        return 1;
+    }
+    float progress() const override { return done ? 1.0f : (float)passesDone / BitonicPassCount(n()); }
+    bool recordable() const override { return !onDevice; }
+
+private:
+    GpuCompute::Keys keys;
+    BitonicPass pass;
+    int passesDone = 0;
+    bool onDevice = false;
+    std::chrono::steady_clock::time_point lastReadback{};
+
+    void runPass() {
+        for (uint32_t i = 0; i < (uint32_t)n(); i++) {
+            if (i & pass.distance) continue;
+            uint32_t j = pass.partner(i);
+            if (j < (uint32_t)n() && less(j, i)) swapAt(i, j);
+        }
+        soundValue = values[n() / 2];
+    }
+    // Bitonic sorts any input, so the CPU starts over on whatever was read back last.
+    void fallBack() {
+        gpuCompute.release(keys);
+        onDevice = false;
+        pass = BitonicPass(); passesDone = 0;
+    }
+};
+
+// --- STEPPER FACTORY ---
+// The modes that can finish small ranges with a sorting network.
+bool UsesNetworkLeaves(SortMode mode);
+
+// Resolves the SortMode once, when a sort starts. Scratch space comes from `arena`,
+// which must not be shared with a stepper that is still in use.
+std::unique_ptr<SortStepper> CreateStepper(SortMode mode, std::vector<int>& values, ScratchArena& arena, bool networkLeaves = false);
+
+// --- INPUT DISTRIBUTIONS ---
+// Each sort starts from a whole array generated at once by one of these (I cycles
+// them, --dist picks one). The shapes cover the cases that separate the algorithms:
+// presorted and nearly sorted runs, heavy duplication, skewed frequencies, and an
+// adversarial input built against a particular pivot rule.
+enum InputDistribution {
+    INPUT_RANDOM, INPUT_SORTED, INPUT_REVERSED, INPUT_NEARLY_SORTED, INPUT_FEW_UNIQUE,
+    INPUT_ORGAN_PIPE, INPUT_SAWTOOTH, INPUT_ZIPF, INPUT_MEDIAN3_KILLER
+};
+const int NUM_INPUT_DISTRIBUTIONS = INPUT_MEDIAN3_KILLER + 1;
+inline const char* const INPUT_DISTRIBUTION_NAMES[NUM_INPUT_DISTRIBUTIONS] = {
+    "random", "sorted", "reversed", "nearly-sorted", "few-unique", "organ-pipe", "sawtooth", "zipf", "median3-killer"
+};
+const int MIN_VALUE = 5;  // Every generated value is at least this
+const int FEW_UNIQUE_VALUES = 4;
+const int SAWTOOTH_TEETH = 8;
+
+extern int nearlySortedSwaps;  // Random swaps applied to sorted input (--swaps); 0 means 1% of N
+
+// Returns the distribution called `name`, or -1.
+int FindInputDistribution(std::string_view name);
+
+// McIlroy's adversary ("A Killer Adversary for Quicksort") played against the
+// median-of-three quicksort of IntroSortStepper. Every value starts out undecided and
+// is only fixed, as small as possible, when a comparison between two undecided
+// values forces it; the pivot candidate is kept undecided for as long as it can be.
+// The resulting input makes each partition split off almost nothing until introsort
+// hits its depth limit and falls back to heapsort.
+void GenerateMedian3Killer(std::vector<int>& out, int range);
+
+// How many values `dist` spreads n elements over: `range`, except for the killer,
+// which needs n distinct values to stay adversarial and so widens it to at least n.
+int InputSpan(InputDistribution dist, int n, int range);
+
+// Fills `out` with n values from [MIN_VALUE, MIN_VALUE + InputSpan(dist, n, range)).
+void GenerateInput(InputDistribution dist, std::vector<int>& out, int n, int range, Xoshiro256& rng);
+
+// --- REFERENCE SORTS ---
+// Plain loop versions of the steppers for the bench (and sortcore_test) to run on any
+// element type. They live next to the steppers so a change to one is easy to mirror in
+// the other.
+struct OpCounts {
+    unsigned long long comparisons = 0;
+    unsigned long long swaps = 0;
+};
+
+// --- ELEMENT TYPES ---
+// The steppers animate int keys, but the references are templates on the element type
+// and comparator, so the bench can show what wider elements and payloads cost. Each
+// type is built from the same generated int keys, which keeps every type's order and
+// ties (and so its comparison counts) the same as int32's. Radix sorts work on
+// order-preserving unsigned bits, one 8-bit digit per byte.
+struct Record16 {
+    int32_t key;
+    uint32_t payload[3];
+};
+
+struct RecordLess {
+    bool operator()(const Record16& a, const Record16& b) const { return a.key < b.key; }
+};
+
+template <typename T> struct ElementTraits;
+
+template <> struct ElementTraits<int> {
+    using Less = std::less<int>;
+    using Bits = uint32_t;
+    static constexpr const char* NAME = "int32";
+    static int FromKey(int key, int) { return key; }
+    static Bits RadixBits(int v) { return RadixKey(v); }
+};
+
+template <> struct ElementTraits<uint64_t> {
+    using Less = std::less<uint64_t>;
+    using Bits = uint64_t;
+    static constexpr const char* NAME = "uint64";
+    // The key in the high half and a hash of it in the low half, so all eight digits vary
+    static uint64_t FromKey(int key, int) { return (uint64_t)RadixKey(key) << 32 | (uint32_t)(RadixKey(key) * 2654435761u); }
+    static Bits RadixBits(uint64_t v) { return v; }
+};
+
+template <> struct ElementTraits<float> {
+    using Less = std::less<float>;
+    using Bits = uint32_t;
+    static constexpr const char* NAME = "float";
+    static float FromKey(int key, int) { return (float)key; }
+    // Negative floats have every bit flipped, positive ones only the sign
+    static Bits RadixBits(float v) { uint32_t b; std::memcpy(&b, &v, sizeof(b)); return b ^ ((b >> 31) ? 0xFFFFFFFFu : 0x80000000u); }
+};
+
+template <> struct ElementTraits<Record16> {
+    using Less = RecordLess;
+    using Bits = uint32_t;
+    static constexpr const char* NAME = "record16";
+    static Record16 FromKey(int key, int k) { return {key, {(uint32_t)k, (uint32_t)k * 2654435761u, ~(uint32_t)k}}; }
+    static Bits RadixBits(const Record16& r) { return RadixKey(r.key); }
+};
+
+template <typename T>
+inline int ElementDigit(const T& x, int digit) { return (int)((ElementTraits<T>::RadixBits(x) >> (digit * RADIX_BITS)) & (RADIX_BUCKETS - 1)); }
+
+template <typename T>
+constexpr int ElementDigits() { return (int)sizeof(typename ElementTraits<T>::Bits); }
+
+// Reference implementations perform the same comparisons and swaps as their steppers,
+// just without the resumable state machine around them.
+template <typename T, typename Less>
+void ReferenceBubbleSort(std::vector<T>& v, OpCounts& c) {
+    unsigned long long cmp = 0, sw = 0;
+    int n = v.size();
+    Less less;
+    for (int i = 0; i < n - 1; i++)
+        for (int j = 0; j < n - 1 - i; j++) {
+            cmp++;
+            if (less(v[j+1], v[j])) { std::swap(v[j], v[j+1]); sw++; }
+        }
+    c.comparisons += cmp; c.swaps += sw;
+}
+
+template <typename T, typename Less>
+void ReferenceSelectionSort(std::vector<T>& v, OpCounts& c) {
+    unsigned long long cmp = 0, sw = 0;
+    int n = v.size();
+    Less less;
+    for (int i = 0; i < n - 1; i++) {
+        int minIdx = i;
+        for (int j = i + 1; j < n; j++) { cmp++; if (less(v[j], v[minIdx])) minIdx = j; }
+        std::swap(v[i], v[minIdx]); sw++;
+    }
+    c.comparisons += cmp; c.swaps += sw;
+}
+
+template <typename T, typename Less>
+void ReferenceInsertionSort(std::vector<T>& v, OpCounts& c) {
+    unsigned long long cmp = 0, sw = 0;
+    int n = v.size();
+    Less less;
+    for (int i = 1; i < n; i++) {
+        for (int j = i; j > 0; j--) {
+            cmp++;
+            if (less(v[j], v[j-1])) { std::swap(v[j], v[j-1]); sw++; }
+            else break;
+        }
+    }
+    c.comparisons += cmp; c.swaps += sw;
+}
+
+// SortStepper::networkSort for the references; used when `networkLeaves` is set. Plain
+// ints take the SIMD kernel. Other types run the same network as compare-exchanges,
+// skipping comparators that reach past the range (the kernel's INT_MAX padding would
+// never move), and count each exchange as a swap.
+template <typename T, typename Less>
+void ReferenceNetworkSort(std::vector<T>& v, int lo, int size, unsigned long long& cmp, unsigned long long& sw) {
+    if (size < 2) return;
+    cmp += NetworkComparators(size);
+    if constexpr (std::is_same_v<T, int> && std::is_same_v<Less, std::less<int>>) {
+        int sorted[NETWORK_MAX_SIZE];
+        std::copy(v.begin() + lo, v.begin() + lo + size, sorted);
+        NetworkSort(sorted, size);
+        for (int k = 0; k < size; k++) if (sorted[k] != v[lo + k]) { v[lo + k] = sorted[k]; sw++; }
+    } else {
+        auto run = [&](const auto& net) {
+            Less less;
+            T* a = v.data() + lo;
+            for (int s = 0; s < net.STAGES; s++)
+                for (int i = 0; i < size; i++) {
+                    int p = net.partner[s][i];
+                    if (i < p && p < size && less(a[p], a[i])) { std::swap(a[i], a[p]); sw++; }
+                }
+        };
+        if (size <= 8) run(BITONIC_NETWORK<8>);
+        else if (size <= 16) run(BITONIC_NETWORK<16>);
+        else run(BITONIC_NETWORK<32>);
+    }
+}
+
+template <typename T, typename Less>
+void ReferenceQuickSort(std::vector<T>& v, OpCounts& c) {
+    if (v.size() < 2) return;
+    unsigned long long cmp = 0, sw = 0;
+    Less less;
+    std::vector<std::pair<int, int>> stack;
+    stack.push_back({0, (int)v.size() - 1});
+    while (!stack.empty()) {
+        auto [l, r] = stack.back(); stack.pop_back();
+        if (networkLeaves && r - l + 1 <= NETWORK_MAX_SIZE) { ReferenceNetworkSort<T, Less>(v, l, r - l + 1, cmp, sw); continue; }
+        int i = l - 1;
+        for (int j = l; j < r; j++) {
+            cmp++;
+            if (less(v[j], v[r])) { i++; std::swap(v[i], v[j]); sw++; }
+        }
+        std::swap(v[i + 1], v[r]); sw++;
+        int p = i + 1;
+        if (p + 1 < r) stack.push_back({p + 1, r});
+        if (l < p - 1) stack.push_back({l, p - 1});
+    }
+    c.comparisons += cmp; c.swaps += sw;
+}
+
+template <typename T, typename Less>
+void ReferenceMergeSort(std::vector<T>& v, OpCounts& c) {
+    unsigned long long cmp = 0, sw = 0;
+    int n = v.size();
+    Less less;
+    int passes = 0;
+    while ((1 << passes) < n) passes++;
+    std::vector<T> scratch(n);
+    T* src = v.data();
+    T* dst = scratch.data();
+    int size = 1;
+    if (networkLeaves && n > 1) { // Network-sorted blocks, sized so an even number of passes remains
+        int merges = 0;
+        while ((NETWORK_MAX_SIZE << merges) < n) merges++;
+        size = merges % 2 == 0 ? NETWORK_MAX_SIZE : NETWORK_MAX_SIZE / 2;
+        for (int left = 0; left < n; left += size) ReferenceNetworkSort<T, Less>(v, left, std::min(size, n - left), cmp, sw);
+    } else if (passes % 2) { // Pairs in place, so an even number of ping-pong passes remains
+        for (int left = 0; left + 1 < n; left += 2) { cmp++; if (less(v[left + 1], v[left])) { std::swap(v[left], v[left + 1]); sw++; } }
+        size = 2;
+    }
+    for (; size < n; size *= 2) {
+        for (int left = 0; left < n; left += 2 * size) {
+            int m = std::min(left + size - 1, n - 1), r = std::min(left + 2 * size - 1, n - 1);
+            int i = left, j = m + 1;
+            for (int k = left; k <= r; k++) {
+                if (i > m) dst[k] = src[j++];
+                else if (j > r) dst[k] = src[i++];
+                else { cmp++; dst[k] = !less(src[j], src[i]) ? src[i++] : src[j++]; }
+                sw++;
+            }
+        }
+        std::swap(src, dst);
+    }
+    c.comparisons += cmp; c.swaps += sw;
+}
+
+// Heapsort of v[lo, hi) with the same sifts as the hybrid steppers' fallback.
+template <typename T, typename Less>
+void ReferenceHeapSort(std::vector<T>& v, int lo, int hi, unsigned long long& cmp, unsigned long long& sw) {
+    int count = hi - lo;
+    Less less;
+    auto sift = [&](int root, int end) {
+        for (int child; (child = 2 * root + 1) < end; root = child) {
+            if (child + 1 < end) { cmp++; if (less(v[lo + child], v[lo + child + 1])) child++; }
+            cmp++;
+            if (!less(v[lo + root], v[lo + child])) break;
+            std::swap(v[lo + root], v[lo + child]); sw++;
+        }
+    };
+    for (int start = count / 2 - 1; start >= 0; start--) sift(start, count);
+    for (int end = count - 1; end >= 1; end--) { std::swap(v[lo], v[lo + end]); sw++; sift(0, end); }
+}
+
+template <typename T, typename Less>
+void ReferenceFullHeapSort(std::vector<T>& v, OpCounts& c) {
+    unsigned long long cmp = 0, sw = 0;
+    ReferenceHeapSort<T, Less>(v, 0, v.size(), cmp, sw);
+    c.comparisons += cmp; c.swaps += sw;
+}
+
+// Same leaves, searches and reversals as InPlaceMergeSortStepper, recursing instead of
+// keeping a stack of merges.
+template <typename T, typename Less>
+void ReferenceInPlaceMergeSort(std::vector<T>& v, OpCounts& c) {
+    unsigned long long cmp = 0, sw = 0;
+    int n = v.size();
+    Less less;
+    auto reverse = [&](int begin, int end) { for (int lo = begin, hi = end - 1; lo < hi; lo++, hi--) { std::swap(v[lo], v[hi]); sw++; } };
+    auto merge = [&](auto& self, int first, int middle, int last) -> void {
+        int len1 = middle - first, len2 = last - middle;
+        if (len1 == 0 || len2 == 0) return;
+        if (len1 + len2 == 2) { cmp++; if (less(v[middle], v[first])) { std::swap(v[first], v[middle]); sw++; } return; }
+        int cut1, cut2;
+        if (len1 > len2) {
+            cut1 = first + len1 / 2; int lo = middle, hi = last;
+            while (lo < hi) { int probe = lo + (hi - lo) / 2; cmp++; if (less(v[probe], v[cut1])) lo = probe + 1; else hi = probe; }
+            cut2 = lo;
+        } else {
+            cut2 = middle + len2 / 2; int lo = first, hi = middle;
+            while (lo < hi) { int probe = lo + (hi - lo) / 2; cmp++; if (!less(v[cut2], v[probe])) lo = probe + 1; else hi = probe; }
+            cut1 = lo;
+        }
+        int newMiddle = cut1 + (cut2 - middle);
+        if (cut1 != middle && cut2 != middle) { reverse(cut1, middle); reverse(middle, cut2); reverse(cut1, cut2); }
+        self(self, first, cut1, newMiddle);
+        self(self, newMiddle, cut2, last);
+    };
+    for (int lo = 0; lo < n; lo += IN_PLACE_LEAF_SIZE) {
+        int hi = std::min(lo + IN_PLACE_LEAF_SIZE, n);
+        for (int i = lo + 1; i < hi; i++)
+            for (int j = i; j > lo; j--) { cmp++; if (!less(v[j], v[j - 1])) break; std::swap(v[j], v[j - 1]); sw++; }
+    }
+    for (int width = IN_PLACE_LEAF_SIZE; width < n; width *= 2)
+        for (int lo = 0; lo + width < n; lo += 2 * width) {
+            cmp++;
+            if (less(v[lo + width], v[lo + width - 1])) merge(merge, lo, lo + width, std::min(lo + 2 * width, n));
+        }
+    c.comparisons += cmp; c.swaps += sw;
+}
+
+template <typename T, typename Less, SortMode SEQUENCE>
+void ReferenceShellSort(std::vector<T>& v, OpCounts& c) {
+    unsigned long long cmp = 0, sw = 0;
+    int n = v.size(), gaps[MAX_SHELL_GAPS];
+    Less less;
+    for (int g = 0, count = ShellGaps(SEQUENCE, n, gaps); g < count; g++) {
+        int gap = gaps[g];
+        for (int i = gap; i < n; i++)
+            for (int j = i; j >= gap; j -= gap) { cmp++; if (!less(v[j], v[j - gap])) break; std::swap(v[j], v[j - gap]); sw++; }
+    }
+    c.comparisons += cmp; c.swaps += sw;
+}
+
+template <typename T, typename Less>
+void ReferenceIntroSort(std::vector<T>& v, OpCounts& c) {
+    unsigned long long cmp = 0, sw = 0;
+    int n = v.size();
+    Less less;
+    auto sort2 = [&](int a, int b) { cmp++; if (less(v[b], v[a])) { std::swap(v[a], v[b]); sw++; } };
+    struct Task { int lo, hi, depth; };
+    std::vector<Task> stack;
+    if (n > 1) stack.push_back({0, n - 1, 2 * FloorLog2(n)});
+    while (!stack.empty()) {
+        auto [l, r, depth] = stack.back(); stack.pop_back();
+        int size = r - l + 1;
+        if (size <= INTRO_INSERTION_CUTOFF && networkLeaves) { ReferenceNetworkSort<T, Less>(v, l, size, cmp, sw); continue; }
+        if (size <= INTRO_INSERTION_CUTOFF) {
+            for (int i = l + 1; i <= r; i++)
+                for (int j = i; j > l; j--) { cmp++; if (!less(v[j], v[j - 1])) break; std::swap(v[j], v[j - 1]); sw++; }
+            continue;
+        }
+        if (depth == 0) { ReferenceHeapSort<T, Less>(v, l, r + 1, cmp, sw); continue; }
+        int mid = l + size / 2;
+        sort2(l, mid); sort2(mid, r); sort2(l, mid);
+        std::swap(v[mid], v[r]); sw++;
+        int i = l - 1;
+        for (int j = l; j < r; j++) { cmp++; if (less(v[j], v[r])) { i++; std::swap(v[i], v[j]); sw++; } }
+        std::swap(v[i + 1], v[r]); sw++;
+        int p = i + 1;
+        if (p + 1 < r) stack.push_back({p + 1, r, depth - 1});
+        if (l < p - 1) stack.push_back({l, p - 1, depth - 1});
+    }
+    c.comparisons += cmp; c.swaps += sw;
+}
+
+template <typename T, typename Less>
+void ReferencePdqSort(std::vector<T>& v, OpCounts& c) {
+    unsigned long long cmp = 0, sw = 0;
+    int n = v.size();
+    auto less = [&, lt = Less()](int a, int b) { cmp++; return lt(v[a], v[b]); };
+    auto swapAt = [&](int a, int b) { std::swap(v[a], v[b]); sw++; };
+    auto sort2 = [&](int a, int b) { if (less(b, a)) swapAt(a, b); };
+    auto sort3 = [&](int a, int b, int c3) { sort2(a, b); sort2(b, c3); sort2(a, b); };
+    // Returns false once more than `limit` moves were needed (limit < 0: no limit)
+    auto insertion = [&](int begin, int end, int limit) {
+        int moves = 0;
+        for (int i = begin + 1; i < end; i++) {
+            for (int j = i; j > begin && less(j, j - 1); j--) { swapAt(j, j - 1); moves++; }
+            if (limit >= 0 && moves > limit) return false;
+        }
+        return true;
+    };
+    struct Frame { int begin, end, badAllowed; bool leftmost; };
+    std::vector<Frame> stack;
+    if (n > 1) stack.push_back({0, n, FloorLog2(n), true});
+    while (!stack.empty()) {
+        Frame f = stack.back(); stack.pop_back();
+        while (true) {
+            int b = f.begin, e = f.end, size = e - b;
+            if (size < PDQ_INSERTION_CUTOFF && networkLeaves) { ReferenceNetworkSort<T, Less>(v, b, size, cmp, sw); break; }
+            if (size < PDQ_INSERTION_CUTOFF) { insertion(b, e, -1); break; }
+            int s2 = size / 2;
+            if (size > PDQ_NINTHER_THRESHOLD) {
+                sort3(b, b + s2, e - 1); sort3(b + 1, b + s2 - 1, e - 2); sort3(b + 2, b + s2 + 1, e - 3); sort3(b + s2 - 1, b + s2, b + s2 + 1);
+                swapAt(b, b + s2);
+            } else {
+                sort3(b + s2, b, e - 1);
+            }
+            if (!f.leftmost && !less(b - 1, b)) {
+                int first = b, last = e;
+                while (less(b, --last));
+                if (last + 1 == e) while (first < last && !less(b, ++first));
+                else while (!less(b, ++first));
+                while (first < last) { swapAt(first, last); while (less(b, --last)); while (!less(b, ++first)); }
+                swapAt(b, last);
+                f.begin = last + 1;
+                continue;
+            }
+            int first = b, last = e;
+            while (less(++first, b));
+            if (first - 1 == b) while (first < last && !less(--last, b));
+            else while (!less(--last, b));
+            bool alreadyPartitioned = first >= last;
+            while (first < last) { swapAt(first, last); while (less(++first, b)); while (!less(--last, b)); }
+            int p = first - 1;
+            swapAt(b, p);
+            int l = p - b, r = e - (p + 1);
+            if (l < size / 8 || r < size / 8) {
+                if (--f.badAllowed == 0) { ReferenceHeapSort<T, Less>(v, b, e, cmp, sw); break; }
+                if (l >= PDQ_INSERTION_CUTOFF) {
+                    swapAt(b, b + l / 4); swapAt(p - 1, p - l / 4);
+                    if (l > PDQ_NINTHER_THRESHOLD) { swapAt(b + 1, b + (l / 4 + 1)); swapAt(b + 2, b + (l / 4 + 2)); swapAt(p - 2, p - (l / 4 + 1)); swapAt(p - 3, p - (l / 4 + 2)); }
+                }
+                if (r >= PDQ_INSERTION_CUTOFF) {
+                    swapAt(p + 1, p + (1 + r / 4)); swapAt(e - 1, e - r / 4);
+                    if (r > PDQ_NINTHER_THRESHOLD) { swapAt(p + 2, p + (2 + r / 4)); swapAt(p + 3, p + (3 + r / 4)); swapAt(e - 2, e - (1 + r / 4)); swapAt(e - 3, e - (2 + r / 4)); }
+                }
+            } else if (alreadyPartitioned && insertion(b, p, PDQ_PARTIAL_INSERTION_LIMIT) && insertion(p + 1, e, PDQ_PARTIAL_INSERTION_LIMIT)) {
+                break;
+            }
+            if (e - (p + 1) > 1) stack.push_back({p + 1, e, f.badAllowed, false});
+            f.end = p;
+        }
+    }
+    c.comparisons += cmp; c.swaps += sw;
+}
+
+template <typename T, typename Less>
+void ReferenceTimSort(std::vector<T>& v, OpCounts& c) {
+    unsigned long long cmp = 0, sw = 0;
+    int n = v.size();
+    if (n < 2) return;
+    Less less;
+    std::vector<T> tmp(n);
+    int minRun = n, odd = 0;
+    while (minRun >= TIM_MIN_MERGE) { odd |= minRun & 1; minRun >>= 1; }
+    minRun += odd;
+    int minGallop = TIM_MIN_GALLOP;
+    // Elements of base[0, len) that are <= key (right) or < key (left)
+    auto gallop = [&](const T& key, const T* base, int len, bool right) {
+        auto before = [&](int k) { cmp++; return right ? !less(key, base[k]) : less(base[k], key); };
+        if (!before(0)) return 0;
+        int last = 0, ofs = 1;
+        while (ofs < len && before(ofs)) { last = ofs; ofs = ofs * 2 + 1; }
+        ofs = std::min(ofs, len);
+        for (last++; last < ofs;) { int m = last + (ofs - last) / 2; if (before(m)) last = m + 1; else ofs = m; }
+        return ofs;
+    };
+    auto mergeLo = [&](int base1, int len1, int base2, int len2) {
+        std::copy(v.begin() + base1, v.begin() + base1 + len1, tmp.begin());
+        int cursor1 = 0, cursor2 = base2, dest = base1;
+        auto take = [&](const T& x) { v[dest++] = x; sw++; };
+        take(v[cursor2++]);
+        if (--len2 > 0 && len1 > 1) {
+            while (true) {
+                int count1 = 0, count2 = 0;
+                bool finished = false;
+                while (!finished && (count1 | count2) < minGallop) {
+                    cmp++;
+                    if (less(v[cursor2], tmp[cursor1])) { take(v[cursor2++]); count2++; count1 = 0; finished = --len2 == 0; }
+                    else { take(tmp[cursor1++]); count1++; count2 = 0; finished = --len1 == 1; }
+                }
+                while (!finished) {
+                    count1 = gallop(v[cursor2], tmp.data() + cursor1, len1, true);
+                    for (int k = 0; k < count1; k++) take(tmp[cursor1++]);
+                    len1 -= count1;
+                    if (len1 <= 1) { finished = true; break; }
+                    take(v[cursor2++]);
+                    if (--len2 == 0) { finished = true; break; }
+                    count2 = gallop(tmp[cursor1], v.data() + cursor2, len2, false);
+                    for (int k = 0; k < count2; k++) take(v[cursor2++]);
+                    len2 -= count2;
+                    if (len2 == 0) { finished = true; break; }
+                    take(tmp[cursor1++]);
+                    if (--len1 == 1) { finished = true; break; }
+                    minGallop--;
+                    if (count1 < TIM_MIN_GALLOP && count2 < TIM_MIN_GALLOP) break;
+                }
+                if (finished) break;
+                if (minGallop < 0) minGallop = 0;
+                minGallop += 2;
+            }
+            if (minGallop < 1) minGallop = 1;
+        }
+        if (len1 == 1) { while (len2-- > 0) take(v[cursor2++]); take(tmp[cursor1]); }
+        else while (len1-- > 0) take(tmp[cursor1++]);
+    };
+    std::vector<int> runBase, runLen;
+    auto mergeAt = [&](int k) {
+        int base1 = runBase[k], len1 = runLen[k], base2 = runBase[k + 1], len2 = runLen[k + 1];
+        runLen[k] = len1 + len2;
+        runBase.erase(runBase.begin() + k + 1); runLen.erase(runLen.begin() + k + 1);
+        int trimmed = gallop(v[base2], v.data() + base1, len1, true);
+        base1 += trimmed; len1 -= trimmed;
+        if (len1 == 0) return;
+        len2 = gallop(v[base1 + len1 - 1], v.data() + base2, len2, false);
+        if (len2 == 0) return;
+        mergeLo(base1, len1, base2, len2);
+    };
+    for (int lo = 0; lo < n;) {
+        int runHi = lo + 1;
+        if (runHi < n) {
+            cmp++;
+            bool descending = less(v[runHi], v[lo]);
+            for (runHi++; runHi < n; runHi++) { cmp++; if (less(v[runHi], v[runHi - 1]) != descending) break; }
+            if (descending) for (int i = lo, j = runHi - 1; i < j; i++, j--) { std::swap(v[i], v[j]); sw++; }
+        }
+        int force = std::min(n - lo, minRun);
+        for (int start = runHi; start < lo + force; start++) {
+            int left = lo, right = start;
+            while (left < right) { int mid = (left + right) / 2; cmp++; if (less(v[start], v[mid])) right = mid; else left = mid + 1; }
+            for (int k = start; k > left; k--) { std::swap(v[k], v[k - 1]); sw++; }
+        }
+        runHi = std::max(runHi, lo + force);
+        runBase.push_back(lo); runLen.push_back(runHi - lo);
+        lo = runHi;
+        while (runLen.size() > 1) {
+            int k = (int)runLen.size() - 2;
+            if ((k > 0 && runLen[k - 1] <= runLen[k] + runLen[k + 1]) || (k > 1 && runLen[k - 2] <= runLen[k - 1] + runLen[k])) {
+                if (runLen[k - 1] < runLen[k + 1]) k--;
+            } else if (runLen[k] > runLen[k + 1]) break;
+            mergeAt(k);
+        }
+    }
+    while (runLen.size() > 1) {
+        int k = (int)runLen.size() - 2;
+        if (k > 0 && runLen[k - 1] < runLen[k + 1]) k--;
+        mergeAt(k);
+    }
+    c.comparisons += cmp; c.swaps += sw;
+}
+
+// The standard library sorts, as the baseline the hybrids are measured against. Only
+// comparisons are counted; the library does not expose its moves.
+template <typename T, typename Less>
+void ReferenceStdSort(std::vector<T>& v, OpCounts& c) {
+    unsigned long long cmp = 0;
+    std::sort(v.begin(), v.end(), [&cmp, less = Less()](const T& a, const T& b) { cmp++; return less(a, b); });
+    c.comparisons += cmp;
+}
+
+template <typename T, typename Less>
+void ReferenceStdStableSort(std::vector<T>& v, OpCounts& c) {
+    unsigned long long cmp = 0;
+    std::stable_sort(v.begin(), v.end(), [&cmp, less = Less()](const T& a, const T& b) { cmp++; return less(a, b); });
+    c.comparisons += cmp;
+}
+
+// --- RADIX HISTOGRAMS ---
+// Every key bumps one counter per digit. Consecutive keys often share a digit (the top
+// bytes of small values always do), and incrementing the same counter back to back
+// stalls on store-to-load forwarding, so keys are spread round-robin over
+// HISTOGRAM_COPIES separate tables that are summed at the end. With AVX2 or NEON the
+// digits of a whole vector of keys are extracted at once.
+const int HISTOGRAM_COPIES = 4;
+
+void HistogramDigits(const int* v, size_t n, uint32_t hist[RADIX_DIGITS][RADIX_BUCKETS]);
+
+// HistogramDigits for any element type: ints take the vector path above, wider or
+// non-integer keys the interleaved scalar loop over their radix bits.
+template <typename T>
+void HistogramElements(const T* v, size_t n, uint32_t hist[][RADIX_BUCKETS]) {
+    if constexpr (std::is_same_v<T, int>) {
+        HistogramDigits(v, n, hist);
+    } else {
+        constexpr int digits = ElementDigits<T>();
+        static thread_local uint32_t copies[HISTOGRAM_COPIES][digits][RADIX_BUCKETS];
+        std::memset(copies, 0, sizeof(copies));
+        for (size_t i = 0; i < n; i++)
+            for (int d = 0; d < digits; d++) copies[i % HISTOGRAM_COPIES][d][ElementDigit(v[i], d)]++;
+        for (int d = 0; d < digits; d++)
+            for (int b = 0; b < RADIX_BUCKETS; b++) {
+                uint32_t sum = 0;
+                for (int c = 0; c < HISTOGRAM_COPIES; c++) sum += copies[c][d][b];
+                hist[d][b] = sum;
+            }
+    }
+}
+
+// The radix and counting sorts order by ElementTraits<T>::RadixBits, which agrees with
+// the type's default comparator; `Less` only keeps their signature in line.
+template <typename T, typename Less>
+void ReferenceLsdRadixSort(std::vector<T>& v, OpCounts& c) {
+    size_t n = v.size();
+    if (n < 2) return;
+    constexpr int digits = ElementDigits<T>();
+    uint32_t hist[digits][RADIX_BUCKETS];
+    HistogramElements(v.data(), n, hist);
+    std::vector<T> scratch(n);
+    for (int d = 0; d < digits; d++) {
+        if (*std::max_element(hist[d], hist[d] + RADIX_BUCKETS) == n) continue; // Same digit everywhere
+        uint32_t fill[RADIX_BUCKETS];
+        for (int b = 0, sum = 0; b < RADIX_BUCKETS; b++) { fill[b] = sum; sum += hist[d][b]; }
+        std::copy(v.begin(), v.end(), scratch.begin());
+        for (const T& x : scratch) v[fill[ElementDigit(x, d)]++] = x;
+        c.swaps += n;
+    }
+}
+
+// Same as the stepper, including falling back to LSD radix sort for wide value spans.
+// Ints are rewritten from their counts; other types are scattered stably by key.
+template <typename T, typename Less>
+void ReferenceCountingSort(std::vector<T>& v, OpCounts& c) {
+    if (v.size() < 2) return;
+    if constexpr (std::is_same_v<T, int>) {
+        int lo, hi;
+        ValueBounds(v, lo, hi);
+        if ((long long)hi - lo >= COUNTING_MAX_BUCKETS) { ReferenceLsdRadixSort<T, Less>(v, c); return; }
+        std::vector<int> counts(hi - lo + 1);
+        for (int x : v) counts[x - lo]++;
+        int k = 0;
+        for (size_t b = 0; b < counts.size(); b++) for (int m = counts[b]; m > 0; m--) v[k++] = lo + (int)b;
+    } else {
+        using Bits = typename ElementTraits<T>::Bits;
+        Bits lo = ElementTraits<T>::RadixBits(v[0]), hi = lo;
+        for (const T& x : v) { lo = std::min(lo, ElementTraits<T>::RadixBits(x)); hi = std::max(hi, ElementTraits<T>::RadixBits(x)); }
+        if (hi - lo >= (Bits)COUNTING_MAX_BUCKETS) { ReferenceLsdRadixSort<T, Less>(v, c); return; }
+        std::vector<uint32_t> start(hi - lo + 1);
+        for (const T& x : v) start[ElementTraits<T>::RadixBits(x) - lo]++;
+        for (uint32_t b = 0, sum = 0; b < start.size(); b++) { uint32_t count = start[b]; start[b] = sum; sum += count; }
+        std::vector<T> scratch(v);
+        for (const T& x : scratch) v[start[ElementTraits<T>::RadixBits(x) - lo]++] = x;
+    }
+    c.swaps += v.size();
+}
+
+template <typename T, typename Less>
+void ReferenceMsdRadixSort(std::vector<T>& v, OpCounts& c) {
+    unsigned long long cmp = 0, sw = 0;
+    int n = v.size();
+    Less less;
+    constexpr int digits = ElementDigits<T>();
+    struct Task { int lo, hi, digit; };
+    std::vector<Task> stack;
+    if (n > 1) stack.push_back({0, n, digits - 1});
+    bool topLevel = true;
+    while (!stack.empty()) {
+        auto [lo, hi, digit] = stack.back(); stack.pop_back();
+        if (hi - lo <= MSD_INSERTION_CUTOFF && networkLeaves) { ReferenceNetworkSort<T, Less>(v, lo, hi - lo, cmp, sw); continue; }
+        if (hi - lo <= MSD_INSERTION_CUTOFF) {
+            for (int i = lo + 1; i < hi; i++)
+                for (int j = i; j > lo; j--) { cmp++; if (!less(v[j], v[j - 1])) break; std::swap(v[j], v[j - 1]); sw++; }
+            continue;
+        }
+        uint32_t count[RADIX_BUCKETS] = {};
+        if (topLevel) {
+            uint32_t hist[digits][RADIX_BUCKETS];
+            HistogramElements(v.data() + lo, hi - lo, hist);
+            while (digit > 0 && *std::max_element(hist[digit], hist[digit] + RADIX_BUCKETS) == (uint32_t)n) digit--;
+            std::copy(hist[digit], hist[digit] + RADIX_BUCKETS, count);
+            topLevel = false;
+        } else {
+            for (int i = lo; i < hi; i++) count[ElementDigit(v[i], digit)]++;
+        }
+        int head[RADIX_BUCKETS], tail[RADIX_BUCKETS];
+        for (int b = 0, sum = lo; b < RADIX_BUCKETS; b++) { head[b] = sum; sum += count[b]; tail[b] = sum; }
+        for (int b = 0; b < RADIX_BUCKETS; b++)
+            while (head[b] < tail[b]) {
+                int d = ElementDigit(v[head[b]], digit);
+                if (d == b) head[b]++;
+                else { std::swap(v[head[b]], v[head[d]++]); sw++; }
+            }
+        for (int b = RADIX_BUCKETS - 1; b >= 0; b--)
+            if (count[b] > 1 && digit > 0) stack.push_back({tail[b] - (int)count[b], tail[b], digit - 1});
+    }
+    c.comparisons += cmp; c.swaps += sw;
+}
+
+template <typename T, typename Less>
+void ReferenceBitonicSort(std::vector<T>& v, OpCounts& c) {
+    unsigned long long cmp = 0, sw = 0;
+    uint32_t n = v.size();
+    Less less;
+    BitonicPass pass;
+    if (n > 1) do {
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t j = pass.partner(i);
+            if ((i & pass.distance) || j >= n) continue;
+            cmp++;
+            if (less(v[j], v[i])) { std::swap(v[i], v[j]); sw++; }
+        }
+    } while (pass.advance(n));
+    c.comparisons += cmp; c.swaps += sw;
+}
+
+// The same network, all of it in one command buffer. The bench only runs it on int32
+// keys with a GPU device; anything else sorts on the CPU.
+template <typename T, typename Less>
+void ReferenceGpuBitonicSort(std::vector<T>& v, OpCounts& c) {
+    if constexpr (std::is_same_v<T, int>) {
+        if (gpuCompute.sort(v.data(), v.size())) {
+            BitonicPass pass;
+            if (v.size() > 1) do c.comparisons += BitonicComparators(v.size(), pass.distance); while (pass.advance(v.size()));
+            return;
+        }
+    }
+    ReferenceBitonicSort<T, Less>(v, c);
+}
+
+// A fixed set of threads, each with its own deque of tasks. A thread runs its newest
+// task first and, when it has none, steals the oldest task of another thread, so work
+// spawned from one big task spreads out across the pool. Used by the threaded
+// reference implementations of the parallel sorts.
+class WorkStealingPool {
+public:
+    using Task = std::function<void(int thread)>;
+
+    explicit WorkStealingPool(int threads) : queues(threads) {
+        for (int t = 0; t < threads; t++) workers.emplace_back([this, t] { run(t); });
+    }
+    ~WorkStealingPool() {
+        { std::lock_guard<std::mutex> lock(idleMutex); quit = true; }
+        workAvailable.notify_all();
+        for (std::thread& w : workers) w.join();
+    }
+
+    int size() const { return (int)queues.size(); }
+
+    // Queues a task on thread `owner`'s deque; tasks may push further tasks.
+    void push(int owner, Task task) {
+        pending.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(queues[owner].mutex);
+            queues[owner].tasks.push_back(std::move(task));
+        }
+        { std::lock_guard<std::mutex> lock(idleMutex); queued++; }
+        workAvailable.notify_one();
+    }
+    // Blocks until every pushed task (and everything they pushed) has finished.
+    void wait() {
+        std::unique_lock<std::mutex> lock(idleMutex);
+        allDone.wait(lock, [this] { return pending.load() == 0; });
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+    std::vector<Queue> queues;
+    std::vector<std::thread> workers;
+    std::atomic<int> pending{0};
+    // Idle workers sleep on workAvailable instead of polling every queue, so the threads
+    // still sorting keep their cores and queue locks to themselves.
+    std::mutex idleMutex;
+    std::condition_variable workAvailable, allDone;
+    int queued = 0;     // Tasks sitting in the queues (guarded by idleMutex)
+    bool quit = false;  // Guarded by idleMutex
+
+    bool take(int t, Task& task) {
+        {
+            std::lock_guard<std::mutex> lock(queues[t].mutex);
+            if (!queues[t].tasks.empty()) { task = std::move(queues[t].tasks.back()); queues[t].tasks.pop_back(); taken(); return true; }
+        }
+        for (int k = 1; k < size(); k++) {
+            Queue& victim = queues[(t + k) % size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) { task = std::move(victim.tasks.front()); victim.tasks.pop_front(); taken(); return true; }
+        }
+        return false;
+    }
+    void taken() { std::lock_guard<std::mutex> lock(idleMutex); queued--; }
+
+    void run(int t) {
+        Task task;
+        for (;;) {
+            if (take(t, task)) {
+                task(t); task = nullptr;
+                if (pending.fetch_sub(1) == 1) { std::lock_guard<std::mutex> lock(idleMutex); allDone.notify_all(); }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(idleMutex);
+            workAvailable.wait(lock, [this] { return quit || queued > 0; });
+            if (quit) return;
+        }
+    }
+};
+
+extern int benchThreads;  // --threads
+const int PARALLEL_GRAIN = 1 << 14; // Ranges smaller than this are not split any further
+
+// Same passes as ReferenceMergeSort, ping-ponging between v and a scratch array, but
+// each pass's independent blocks (and the first pass's pairs or network blocks) are
+// divided among the pool's threads, which meet at pool.wait() before src and dst swap.
+// The last passes have fewer blocks than threads, which is where a bottom-up merge
+// sort runs out of parallelism. Like the stepper, a pass copies its lone trailing
+// element across without counting it as a move.
+template <typename T, typename Less>
+void ReferenceParallelMergeSort(std::vector<T>& v, OpCounts& c) {
+    int n = v.size();
+    Less less;
+    int passes = 0;
+    while ((1 << passes) < n) passes++;
+    std::vector<T> scratch(n);
+    T* src = v.data();
+    T* dst = scratch.data();
+    std::atomic<unsigned long long> cmpTotal{0}, swTotal{0};
+    WorkStealingPool pool(benchThreads);
+    int size = 1;
+    if ((networkLeaves && n > 1) || passes % 2) { // Sorted in place so an even number of ping-pong passes remains
+        bool network = networkLeaves;
+        if (network) {
+            int merges = 0;
+            while ((NETWORK_MAX_SIZE << merges) < n) merges++;
+            size = merges % 2 == 0 ? NETWORK_MAX_SIZE : NETWORK_MAX_SIZE / 2;
+        } else {
+            size = 2;
+        }
+        for (int first = 0, task = 0; first < n; first += PARALLEL_GRAIN, task++) {
+            int last = std::min(n, first + PARALLEL_GRAIN);
+            pool.push(task % pool.size(), [&, first, last, size, network](int) {
+                unsigned long long cmp = 0, sw = 0;
+                for (int left = first; left < last; left += size) {
+                    if (network) ReferenceNetworkSort<T, Less>(v, left, std::min(size, n - left), cmp, sw);
+                    else if (left + 1 < n) { cmp++; if (less(v[left + 1], v[left])) { std::swap(v[left], v[left + 1]); sw++; } }
+                }
+                cmpTotal += cmp; swTotal += sw;
+            });
+        }
+        pool.wait();
+    }
+    for (; size < n; size *= 2) {
+        int blockSpan = 2 * size;
+        int blocksPerTask = std::max(1, PARALLEL_GRAIN / blockSpan);
+        for (int first = 0, task = 0; first < n; first += blocksPerTask * blockSpan, task++) {
+            int last = (int)std::min<long long>(n, first + (long long)blocksPerTask * blockSpan);
+            pool.push(task % pool.size(), [&, first, last, size, src, dst](int) {
+                unsigned long long cmp = 0, sw = 0;
+                for (int left = first; left < last; left += 2 * size) {
+                    if (left == n - 1) { dst[left] = src[left]; continue; }
+                    int m = std::min(left + size - 1, n - 1), r = std::min(left + 2 * size - 1, n - 1);
+                    int i = left, j = m + 1;
+                    for (int k = left; k <= r; k++) {
+                        if (i > m) dst[k] = src[j++];
+                        else if (j > r) dst[k] = src[i++];
+                        else { cmp++; dst[k] = !less(src[j], src[i]) ? src[i++] : src[j++]; }
+                        sw++;
+                    }
+                }
+                cmpTotal += cmp; swTotal += sw;
+            });
+        }
+        pool.wait();
+        std::swap(src, dst);
+    }
+    c.comparisons += cmpTotal; c.swaps += swTotal;
+}
+
+// Same partitions as ReferenceQuickSort. Every partition of a large range pushes both
+// halves back onto the partitioning thread's deque, where idle threads can steal them.
+template <typename T, typename Less>
+void ReferenceParallelQuickSort(std::vector<T>& v, OpCounts& c) {
+    if (v.size() < 2) return;
+    Less less;
+    std::atomic<unsigned long long> cmpTotal{0}, swTotal{0};
+    WorkStealingPool pool(benchThreads);
+    std::function<void(int, int, int)> sortRange = [&](int thread, int lo, int hi) {
+        unsigned long long cmp = 0, sw = 0;
+        std::vector<std::pair<int, int>> stack;
+        stack.push_back({lo, hi});
+        while (!stack.empty()) {
+            auto [l, r] = stack.back(); stack.pop_back();
+            int i = l - 1;
+            for (int j = l; j < r; j++) {
+                cmp++;
+                if (less(v[j], v[r])) { i++; std::swap(v[i], v[j]); sw++; }
+            }
+            std::swap(v[i + 1], v[r]); sw++;
+            int p = i + 1;
+            bool split = r - l >= PARALLEL_GRAIN;
+            if (p + 1 < r) {
+                if (split) pool.push(thread, [&sortRange, a = p + 1, b = r](int t) { sortRange(t, a, b); });
+                else stack.push_back({p + 1, r});
+            }
+            if (l < p - 1) {
+                if (split) pool.push(thread, [&sortRange, a = l, b = p - 1](int t) { sortRange(t, a, b); });
+                else stack.push_back({l, p - 1});
+            }
+        }
+        cmpTotal += cmp; swTotal += sw;
+    };
+    pool.push(0, [&](int t) { sortRange(t, 0, (int)v.size() - 1); });
+    pool.wait();
+    c.comparisons += cmpTotal; c.swaps += swTotal;
+}
+
+template <typename T, typename Less>
+struct BenchAlgorithm {
+    SortMode mode;
+    const char* id;
+    void (*reference)(std::vector<T>&, OpCounts&);
+    bool quadratic;
+    const char* baseline = nullptr;  // Id of the algorithm this one reports its speedup against
+    bool library = false;  // A standard library sort: reference row only
+    bool gpu = false;      // Runs on the GPU device: int32 keys only, skipped without one
+};
+
+// The same table for every element type, each entry instantiated for that type.
+template <typename T, typename Less>
+inline constexpr BenchAlgorithm<T, Less> BENCH_ALGORITHMS[] = {
+    {BUBBLE_SORT, "bubble", ReferenceBubbleSort<T, Less>, true},
+    {SELECTION_SORT, "selection", ReferenceSelectionSort<T, Less>, true},
+    {INSERTION_SORT, "insertion", ReferenceInsertionSort<T, Less>, true},
+    {QUICK_SORT, "quick", ReferenceQuickSort<T, Less>, false},
+    {MERGE_SORT, "merge", ReferenceMergeSort<T, Less>, false},
+    {PARALLEL_MERGE_SORT, "pmerge", ReferenceParallelMergeSort<T, Less>, false, "merge"},
+    {PARALLEL_QUICK_SORT, "pquick", ReferenceParallelQuickSort<T, Less>, false, "quick"},
+    {INTRO_SORT, "intro", ReferenceIntroSort<T, Less>, false, "std_sort"},
+    {PDQ_SORT, "pdq", ReferencePdqSort<T, Less>, false, "std_sort"},
+    {TIM_SORT, "tim", ReferenceTimSort<T, Less>, false, "std_stable"},
+    {INTRO_SORT, "std_sort", ReferenceStdSort<T, Less>, false, nullptr, true},
+    {TIM_SORT, "std_stable", ReferenceStdStableSort<T, Less>, false, nullptr, true},
+    {COUNTING_SORT, "counting", ReferenceCountingSort<T, Less>, false, "std_sort"},
+    {LSD_RADIX_SORT, "lsd", ReferenceLsdRadixSort<T, Less>, false, "std_sort"},
+    {MSD_RADIX_SORT, "msd", ReferenceMsdRadixSort<T, Less>, false, "std_sort"},
+    {BITONIC_SORT, "bitonic", ReferenceBitonicSort<T, Less>, false, "std_sort"},
+    {GPU_BITONIC_SORT, "gpu_bitonic", ReferenceGpuBitonicSort<T, Less>, false, "bitonic", false, true},
+    {HEAP_SORT, "heap", ReferenceFullHeapSort<T, Less>, false, "std_sort"},
+    {IN_PLACE_MERGE_SORT, "inplace_merge", ReferenceInPlaceMergeSort<T, Less>, false, "merge"},
+    {SHELL_SORT_CIURA, "shell_ciura", ReferenceShellSort<T, Less, SHELL_SORT_CIURA>, false, "std_sort"},
+    {SHELL_SORT_KNUTH, "shell_knuth", ReferenceShellSort<T, Less, SHELL_SORT_KNUTH>, false, "std_sort"},
+    {SHELL_SORT_HALVING, "shell_halving", ReferenceShellSort<T, Less, SHELL_SORT_HALVING>, true, "std_sort"},
+};
+
+// The row of the algorithm called `id`, or -1.
+template <typename T, typename Less>
+constexpr int FindBenchAlgorithm(std::string_view id) {
+    for (size_t a = 0; a < std::size(BENCH_ALGORITHMS<T, Less>); a++)
+        if (id == BENCH_ALGORITHMS<T, Less>[a].id) return (int)a;
+    return -1;
+}
+
+// Checked at compile time, so renaming or removing a row can't leave a dangling baseline.
+template <typename T, typename Less>
+constexpr bool BenchBaselinesExist() {
+    for (const BenchAlgorithm<T, Less>& algo : BENCH_ALGORITHMS<T, Less>)
+        if (algo.baseline && FindBenchAlgorithm<T, Less>(algo.baseline) < 0) return false;
+    return true;
+}
+static_assert(BenchBaselinesExist<int, std::less<int>>(), "a bench baseline names no algorithm");
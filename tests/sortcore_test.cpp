@@ -0,0 +1,118 @@
+// Correctness checks for sortcore: every stepper, with and without network leaves, on
+// every input distribution and a spread of sizes around the leaf and network cutoffs.
+// A stepper must leave the array sorted and holding the same values, never report more
+// than MAX_HIGHLIGHTS highlights, and count exactly the comparisons and swaps of its
+// reference. The stable references must also keep equal keys in input order, which
+// (with the count parity) is what holds the stable steppers to it too: their int keys
+// carry no payload to check. Prints each failure and exits non-zero if there was one.
+#include "sortcore.h"
+
+#include <iostream>
+#include <sstream>
+
+// --- CASES ---
+const uint64_t TEST_SEED = 1;
+const int TEST_SIZES[] = {0, 1, 2, 3, 7, 16, 17, 31, 32, 33, 100, 1000, 4097};
+const int TEST_RANGES[] = {4, 1 << 20};  // Heavy duplication, and mostly distinct keys
+const int TEST_QUADRATIC_LIMIT = 1000;   // O(N^2) sorts are skipped above this N
+
+// The algorithms that promise to keep equal keys in input order.
+const char* const STABLE_ALGORITHMS[] = {"bubble", "insertion", "merge", "pmerge", "tim", "std_stable", "counting", "lsd", "inplace_merge"};
+
+using IntAlgorithm = BenchAlgorithm<int, std::less<int>>;
+
+int failures = 0;
+int cases = 0;
+
+void Fail(const std::string& what) {
+    if (failures++ < 50) std::cerr << "FAIL " << what << "\n";
+}
+
+std::vector<int> CaseInput(int dist, int n, int range) {
+    Xoshiro256 rng(TEST_SEED ^ (uint64_t)dist << 40 ^ (uint64_t)n ^ (uint64_t)range << 20);
+    std::vector<int> keys;
+    GenerateInput((InputDistribution)dist, keys, n, range, rng);
+    return keys;
+}
+
+// Runs `algo`'s stepper on `input` and checks it against a sorted copy and the reference.
+void CheckStepper(const IntAlgorithm& algo, bool network, const std::vector<int>& input, const std::string& name, ScratchArena& arena) {
+    std::vector<int> expected = input;
+    std::sort(expected.begin(), expected.end());
+
+    std::vector<int> v = input;
+    std::unique_ptr<SortStepper> s = CreateStepper(algo.mode, v, arena, network);
+    Highlight marks[MAX_HIGHLIGHTS * 2];
+    unsigned long long steps = 0, limit = 64ull * (v.size() + 2) * (v.size() + 2) + 4096;
+    while (!s->isDone() && steps++ < limit) {
+        s->step();
+        if (s->highlights(marks) > MAX_HIGHLIGHTS) { Fail(name + ": more than MAX_HIGHLIGHTS highlights"); break; }
+    }
+    if (!s->isDone()) { Fail(name + ": did not finish"); return; }
+    if (!std::is_sorted(v.begin(), v.end())) Fail(name + ": output is not sorted");
+    else if (v != expected) Fail(name + ": output is not a permutation of the input");
+
+    std::vector<int> r = input;
+    OpCounts c;
+    networkLeaves = network;
+    algo.reference(r, c);
+    networkLeaves = false;
+    if (r != expected) Fail(name + ": reference output is not sorted");
+    std::ostringstream counts;
+    counts << name << ": stepper counted " << s->comparisons << " comparisons, " << s->swaps << " swaps; reference "
+           << c.comparisons << ", " << c.swaps;
+    if (s->comparisons != c.comparisons || (!algo.gpu && s->swaps != c.swaps)) Fail(counts.str());
+}
+
+// Sorts records whose payload is their input position, and checks that equal keys
+// come out in that order.
+void CheckStability(const BenchAlgorithm<Record16, RecordLess>& algo, const std::vector<int>& keys, const std::string& name) {
+    std::vector<Record16> v(keys.size());
+    for (size_t k = 0; k < keys.size(); k++) v[k] = ElementTraits<Record16>::FromKey(keys[k], (int)k);
+    OpCounts c;
+    algo.reference(v, c);
+    for (size_t k = 1; k < v.size(); k++) {
+        if (v[k].key < v[k - 1].key) { Fail(name + ": records are not sorted"); return; }
+        if (v[k].key == v[k - 1].key && v[k].payload[0] < v[k - 1].payload[0]) { Fail(name + ": equal keys were reordered"); return; }
+    }
+}
+
+int main() {
+    ScratchArena arena;
+    bool gpu = gpuCompute.ready();
+    const auto& algorithms = BENCH_ALGORITHMS<int, std::less<int>>;
+    for (size_t a = 0; a < std::size(algorithms); a++) {
+        const IntAlgorithm& algo = algorithms[a];
+        // Library sorts have no stepper, and each mode's steppers are checked once
+        if (algo.library || (algo.gpu && !gpu)) continue;
+        if (std::any_of(algorithms, algorithms + a, [&](const IntAlgorithm& o) { return !o.library && o.mode == algo.mode; })) continue;
+        for (int network = 0; network <= UsesNetworkLeaves(algo.mode); network++)
+            for (int d = 0; d < NUM_INPUT_DISTRIBUTIONS; d++)
+                for (int n : TEST_SIZES)
+                    for (int range : TEST_RANGES) {
+                        if (algo.quadratic && n > TEST_QUADRATIC_LIMIT) continue;
+                        std::ostringstream name;
+                        name << algo.id << (network ? "/network/" : "/") << INPUT_DISTRIBUTION_NAMES[d] << "/n=" << n << "/range=" << range;
+                        CheckStepper(algo, network, CaseInput(d, n, range), name.str(), arena);
+                        cases++;
+                    }
+    }
+    if (!gpu) std::cerr << "gpu_bitonic skipped: " << gpuCompute.status() << "\n";
+
+    for (const auto& algo : BENCH_ALGORITHMS<Record16, RecordLess>) {
+        if (std::none_of(std::begin(STABLE_ALGORITHMS), std::end(STABLE_ALGORITHMS), [&](const char* id) { return std::string_view(id) == algo.id; })) continue;
+        for (int d = 0; d < NUM_INPUT_DISTRIBUTIONS; d++)
+            for (int n : TEST_SIZES)
+                for (int range : TEST_RANGES) {
+                    if (algo.quadratic && n > TEST_QUADRATIC_LIMIT) continue;
+                    std::ostringstream name;
+                    name << algo.id << "/stability/" << INPUT_DISTRIBUTION_NAMES[d] << "/n=" << n << "/range=" << range;
+                    CheckStability(algo, CaseInput(d, n, range), name.str());
+                    cases++;
+                }
+    }
+    gpuCompute.shutdown();
+
+    std::cout << cases << " cases, " << failures << " failures\n";
+    return failures ? 1 : 0;
+}